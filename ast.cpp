@@ -1,106 +1,211 @@
 #include "ast.h"
+#include "visit.h"
 #include "debug.h"
+#include "pool.h"
+#include "trace.h"
+#include <sstream>
+#include <cstdlib>
+#include <vector>
 
 using namespace std;
 
-void print_program_ast(st_list* root) {
-    cout << "(program" << endl;
-    cout << "[ ";
-    print_stmt_list(root);
-    cout << "] ";
-    cout << endl << ") ";
+/*
+ * AST nodes are bump allocated from blocks that are never returned to the
+ * system: ast_reset drops every node at once and the next program reuses the
+ * blocks, so a long running server does not go back to malloc per node
+ */
+static const size_t arena_block = 64 * 1024;
+
+struct arena {
+    vector<char*> blocks;
+    size_t current;         // block being filled
+    size_t used;            // bytes used in it
+    size_t counted[mem_categories];     // node bytes charged by kind, given back by ast_reset
+};
+
+static thread_local arena nodes = {vector<char*>(), 0, 0, {0}};
+
+void* ast_alloc(size_t size, mem_category what) {
+    size = (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+    if (nodes.blocks.empty() || nodes.used + size > arena_block) {
+        if (!nodes.blocks.empty())
+            nodes.current++;
+        if (nodes.current == nodes.blocks.size()) {
+            nodes.blocks.push_back((char*) malloc(arena_block));
+            if (mem_tracking)
+                mem_allocated(mem_arena, arena_block);
+        }
+        nodes.used = 0;
+    }
+    void* p = nodes.blocks[nodes.current] + nodes.used;
+    nodes.used += size;
+    if (mem_tracking) {
+        mem_allocated(what, size);
+        nodes.counted[what] += size;
+    }
+    return p;
+}
+
+void ast_reset() {
+    nodes.current = 0;
+    nodes.used = 0;
+    for (int i = 0; i < mem_categories; i++) {
+        if (nodes.counted[i] > 0)
+            mem_freed((mem_category) i, nodes.counted[i]);
+        nodes.counted[i] = 0;
+    }
+}
+
+vector<stmt_range> split_stmt_list(st_list* root, int n) {
+    size_t count = 0;
+    for (st_list* sl = root; sl != NULL; sl = sl->r_child)
+        count++;
+
+    vector<stmt_range> chunks;
+    if (count == 0)
+        return chunks;
+    size_t runs = n < 1 ? 1 : (size_t) n < count ? n : count;
+    size_t size = (count + runs - 1) / runs;
+    size_t i = 0;
+    for (st_list* sl = root; sl != NULL; sl = sl->r_child, i++) {
+        if (i % size == 0) {
+            if (!chunks.empty())
+                chunks.back().last = sl;
+            stmt_range chunk = {sl, NULL};
+            chunks.push_back(chunk);
+        }
+    }
+    return chunks;
 }
 
-void print_stmt_list(st_list *root) {
-    if (root->l_child != NULL) {
-        cout << "(";
-        switch(root->l_child->type) {
-            case t_id:
-                cout << ":= \"" << root->l_child->id << "\"";
-                print_relation(root->l_child->rel);
-                break;
-            case t_read:
-                cout << "read \"" << root->l_child->id << "\"";
-                break;
-            case t_write:
-                cout << "write ";
-                print_relation(root->l_child->rel);
-                break;
-            case t_do:
-                cout << "do" << endl;
-
-                cout << "[";
-                print_stmt_list(root->l_child->sl);
-                cout << "]" << endl;
-                break;
-            case t_if:
-                cout << "if " << endl;
-                print_relation(root->l_child->rel);
-
-                cout << endl;
-                cout << "[";
-                print_stmt_list(root->l_child->sl);
-                cout << "]" << endl;
-                break;
-            case t_check:
-                cout << "check ";
-                print_relation(root->l_child->rel);
-                break;
-            default:
-                cerr << "wrong type" << endl;
+void print_program_ast(st_list* root, ostream& out, int jobs) {
+    out << "(program" << endl;
+    out << "[ ";
+    if (jobs > 1) {
+        // every chunk prints into its own buffer, they are appended in order
+        vector<stmt_range> chunks = split_stmt_list(root, jobs * 4);
+        vector<output_buffer> text(chunks.size());
+        vector<ostringstream> diag(chunks.size());
+        parallel_for(chunks.size(), jobs, [&](int i) {
+            trace_span span("print chunk");
+            diag_out = &diag[i];
+            print_stmts(chunks[i].first, chunks[i].last, text[i]);
+        });
+        for (size_t i = 0; i < chunks.size(); i++) {
+            out << text[i].str();
+            *diag_out << diag[i].str();
         }
-        cout << ")" << endl;
+    } else {
+        print_stmts(root, NULL, out);
     }
-    if (root->r_child != NULL)
-        print_stmt_list(root->r_child);
+    out << "] ";
+    out << endl << ") ";
+}
+
+void print_stmts(st_list* first, st_list* last, ostream& out) {
+    ast_printer(out).walk(first, last);
+}
+
+void print_stmt(st* statement, ostream& out) {
+    ast_printer(out).visit(statement);
+}
+
+// the relation of a statement; a single operand is spaced off as it was when a wrapper node held it
+static void print_operand(bin_op* rel, ostream& out) {
+    if (rel->l_child == NULL && rel->r_child == NULL)
+        out << " ";
+    print_relation(rel, out);
+}
+
+// a do or an if is closed by leave once its body is printed
+bool ast_printer::enter(st* statement) {
+    out << "(";
+    switch(statement->type) {
+        case t_id:
+            out << ":= \"" << statement->id << "\"";
+            print_operand(statement->rel, out);
+            break;
+        case t_read:
+            out << "read \"" << statement->id << "\"";
+            break;
+        case t_write:
+            out << "write ";
+            print_operand(statement->rel, out);
+            break;
+        case t_do:
+            out << "do" << endl;
+
+            out << "[";
+            return true;
+        case t_if:
+            out << "if " << endl;
+            print_operand(statement->rel, out);
+
+            out << endl;
+            out << "[";
+            return true;
+        case t_check:
+            out << "check ";
+            print_operand(statement->rel, out);
+            break;
+        default:
+            *diag_out << "wrong type" << endl;
+    }
+    out << ")" << endl;
+    return false;
+}
+
+void ast_printer::leave(st*) {
+    out << "]" << endl;
+    out << ")" << endl;
 }
 
 // prefix tree traversal
-void print_relation(bin_op* root) {
+void print_relation(bin_op* root, ostream& out) {
     if (root->l_child != NULL && root->r_child != NULL) {
         AST(" (");
-        cout << " (";
+        out << " (";
     }
 
     if (root) {
         if (root->type == t_id) {
-            cout << "(id \"";
-            cout << root->name;
-            cout << "\")";
+            out << "(id \"";
+            out << root->name;
+            out << "\")";
             AST("(id \"");
             AST(root->name);
             AST("\")");
         }
         else if (root->type == t_literal) {
-            cout << "(num \"";
-            cout << root->name;
-            cout << "\")";
+            out << "(num \"";
+            out << root->name;
+            out << "\")";
             AST("(num \"");
             AST(root->name);
             AST("\")");
         }
         else {
             // print op
-            cout << root->name;
+            out << root->name;
             AST(root->name);
         }
     }
 
     if (root->l_child) {
-        cout << " ";
+        out << " ";
         AST(" ");
-        print_relation(root->l_child);
+        print_relation(root->l_child, out);
     }
 
     if (root->r_child) {
-        cout << " ";
+        out << " ";
         AST(" ");
-        print_relation(root->r_child);
+        print_relation(root->r_child, out);
     }
 
     if (root->l_child != NULL && root->r_child != NULL) {
         AST(")");
-        cout << ")";
+        out << ")";
     }
 }
 
@@ -2,7 +2,10 @@
 #define __AST_H
 
 #include <iostream>
+#include <cstddef>
+#include <vector>
 #include "scan.h"
+#include "memstat.h"
 
 typedef struct _st_list st_list;
 typedef struct _st st;
@@ -20,6 +23,7 @@ struct _st_list {
 
 struct _st {
     token type;         // id, read, write, if, do, check
+    int line;           // where the statement starts in the source
     char id[100];
     bin_op* rel;
     st_list* sl;
@@ -32,8 +36,23 @@ struct _bin_op {
     struct _bin_op* r_child;
 };
 
-void print_program_ast(st_list* root);
-void print_stmt_list(st_list *root);
-void print_relation(bin_op* root);
+// top-level statements from first up to, not including, last (NULL: to the end)
+struct stmt_range {
+    st_list* first;
+    st_list* last;
+};
+
+// at most n runs of consecutive statements, about the same number in each
+std::vector<stmt_range> split_stmt_list(st_list* root, int n);
+
+// jobs > 1 prints runs of top-level statements on that many threads, same output
+void print_program_ast(st_list* root, std::ostream& out, int jobs = 1);
+void print_stmts(st_list* first, st_list* last, std::ostream& out);
+void print_stmt(st* statement, std::ostream& out);
+void print_relation(bin_op* root, std::ostream& out);
+
+// what: mem_st_list, mem_st or mem_bin_op, for --mem-stats
+void* ast_alloc(size_t size, mem_category what);
+void ast_reset();
 
 #endif
@@ -0,0 +1,326 @@
+#include "astbin.h"
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const char ast_bin_magic[4] = {'C', 'A', 'S', 'T'};
+
+static void put_varint(string& out, unsigned long long v) {
+    while (v >= 0x80) {
+        out += (char) ((v & 0x7f) | 0x80);
+        v >>= 7;
+    }
+    out += (char) v;
+}
+
+static void put_bits(string& out, const vector<bool>& bits) {
+    put_varint(out, bits.size());
+    for (size_t i = 0; i < bits.size(); i += 8) {
+        unsigned char byte = 0;
+        for (size_t j = 0; j < 8 && i + j < bits.size(); j++)
+            if (bits[i + j])
+                byte |= 1 << j;
+        out += (char) byte;
+    }
+}
+
+struct ast_writer {
+    string body;
+    map<string, int, less<> > index;
+    vector<const char*> strings;        // by index
+};
+
+static void put_name(ast_writer& w, const char* name) {
+    map<string, int, less<> >::iterator found = w.index.find(string_view(name));
+    if (found == w.index.end()) {
+        found = w.index.insert(make_pair(string(name), (int) w.strings.size())).first;
+        w.strings.push_back(name);
+    }
+    put_varint(w.body, found->second);
+}
+
+static void put_expr(ast_writer& w, bin_op* node) {
+    put_varint(w.body, (node->type + 1) << 2 | (node->l_child != NULL) << 1 | (node->r_child != NULL));
+    put_name(w, node->name);
+    if (node->l_child)
+        put_expr(w, node->l_child);
+    if (node->r_child)
+        put_expr(w, node->r_child);
+}
+
+static void put_list(ast_writer& w, st_list* sl);
+
+static void put_stmt(ast_writer& w, st* s) {
+    if (!s) {
+        put_varint(w.body, 0);
+        return;
+    }
+    put_varint(w.body, (s->type + 1) << 2 | (s->rel != NULL) << 1 | (s->sl != NULL));
+    put_varint(w.body, s->line);
+    put_name(w, s->id);
+    if (s->rel)
+        put_expr(w, s->rel);
+    if (s->sl)
+        put_list(w, s->sl);
+}
+
+static void put_list(ast_writer& w, st_list* sl) {
+    size_t count = 0;
+    for (st_list* node = sl; node != NULL; node = node->r_child)
+        count++;
+    put_varint(w.body, count);
+    for (; sl != NULL; sl = sl->r_child)
+        put_stmt(w, sl->l_child);
+}
+
+void write_ast_bin(const parsed_program& program, ostream& out) {
+    ast_writer w;
+    put_list(w, program.root);
+
+    string head(ast_bin_magic, sizeof(ast_bin_magic));
+    put_varint(head, ast_bin_version);
+    put_varint(head, program.syntax_error ? 1 : 0);
+    put_varint(head, w.strings.size());
+    for (size_t i = 0; i < w.strings.size(); i++) {
+        size_t length = strlen(w.strings[i]);
+        put_varint(head, length);
+        head.append(w.strings[i], length);
+    }
+    put_bits(head, program.semantics.do_has_check);
+    put_bits(head, program.semantics.check_in_do);
+
+    out.write(head.data(), head.size());
+    out.write(w.body.data(), w.body.size());
+}
+
+/*
+ * reading never trusts the file: every read is bounds checked, a bad varint,
+ * string index, token, length, a node whose children do not fit its type or
+ * one nested deeper than ast_bin_max_depth marks the reader bad and everything
+ * after that reads as 0, so the nodes stay well formed until the caller gives up
+ */
+struct ast_reader {
+    const unsigned char* pos;
+    const unsigned char* end;
+    bool bad;
+    int depth;
+    vector<string_view> strings;
+};
+
+static unsigned long long get_varint(ast_reader& r) {
+    unsigned long long v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (r.pos == r.end)
+            break;
+        unsigned char byte = *r.pos++;
+        v |= (unsigned long long) (byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return v;
+    }
+    r.bad = true;
+    r.pos = r.end;
+    return 0;
+}
+
+static void get_bits(ast_reader& r, vector<bool>& bits) {
+    unsigned long long count = get_varint(r);
+    if (count > (unsigned long long) (r.end - r.pos) * 8) {
+        r.bad = true;
+        return;
+    }
+    bits.resize(count);
+    for (size_t i = 0; i < count; i++)
+        bits[i] = r.pos[i / 8] >> (i % 8) & 1;
+    r.pos += (count + 7) / 8;
+}
+
+// the name must fit the 100 chars of st::id and bin_op::name
+static void get_name(ast_reader& r, char* name) {
+    unsigned long long i = get_varint(r);
+    if (i >= r.strings.size() || r.strings[i].size() >= 100) {
+        r.bad = true;
+        name[0] = '\0';
+        return;
+    }
+    memcpy(name, r.strings[i].data(), r.strings[i].size());
+    name[r.strings[i].size()] = '\0';
+}
+
+// the token of a tag, t_none if there is none
+static token get_type(ast_reader& r, unsigned long long tag) {
+    if ((tag >> 2) == 0 || (tag >> 2) > t_none + 1) {
+        r.bad = true;
+        return t_none;
+    }
+    return (token) ((tag >> 2) - 1);
+}
+
+// the children the parser gives an expression of this type: operators both, the rest none
+static bool expr_fits(token type, unsigned long long tag) {
+    switch (type) {
+        case t_add:
+        case t_sub:
+        case t_mul:
+        case t_div:
+        case t_eq:
+        case t_noteq:
+        case t_lt:
+        case t_gt:
+        case t_lte:
+        case t_gte:
+            return (tag & 3) == 3;
+        case t_id:
+        case t_literal:
+        case t_none:        // an operand recovery could not salvage
+            return (tag & 3) == 0;
+        default:
+            return false;
+    }
+}
+
+// the same for statements: rel on assign, write, check and if, sl on do and if
+static bool stmt_fits(token type, unsigned long long tag) {
+    switch (type) {
+        case t_id:
+        case t_write:
+        case t_check:
+            return (tag & 3) == 2;
+        case t_if:
+            return (tag & 3) == 3;
+        case t_do:
+            return (tag & 3) == 1;
+        case t_read:
+        case t_none:        // a statement recovery abandoned
+            return (tag & 3) == 0;
+        default:
+            return false;
+    }
+}
+
+static bin_op* get_expr(ast_reader& r) {
+    unsigned long long tag = get_varint(r);
+    bin_op* node = (bin_op*) ast_alloc(sizeof(bin_op), mem_bin_op);
+    node->type = get_type(r, tag);
+    get_name(r, node->name);
+    node->l_child = NULL;
+    node->r_child = NULL;
+    if (!expr_fits(node->type, tag) || r.depth == ast_bin_max_depth)
+        r.bad = true;
+    if (r.bad)
+        return node;
+    r.depth++;
+    if (tag & 2)
+        node->l_child = get_expr(r);
+    if (tag & 1)
+        node->r_child = get_expr(r);
+    r.depth--;
+    return node;
+}
+
+static st_list* get_list(ast_reader& r);
+
+static st* get_stmt(ast_reader& r) {
+    unsigned long long tag = get_varint(r);
+    if (tag == 0)
+        return NULL;
+    st* s = (st*) ast_alloc(sizeof(st), mem_st);
+    s->type = get_type(r, tag);
+    s->line = get_varint(r);
+    get_name(r, s->id);
+    s->rel = NULL;
+    s->sl = NULL;
+    if (!stmt_fits(s->type, tag) || r.depth == ast_bin_max_depth)
+        r.bad = true;
+    if (r.bad)
+        return s;
+    r.depth++;
+    if (tag & 2)
+        s->rel = get_expr(r);
+    if (tag & 1)
+        s->sl = get_list(r);
+    r.depth--;
+    return s;
+}
+
+static st_list* get_list(ast_reader& r) {
+    unsigned long long count = get_varint(r);
+    if (count == 0 || count > (unsigned long long) (r.end - r.pos)) {
+        r.bad = true;
+        count = 1;
+    }
+
+    st_list* head = (st_list*) ast_alloc(sizeof(st_list), mem_st_list);
+    st_list* sl = head;
+    for (unsigned long long i = 0; ; i++) {
+        sl->l_child = r.bad ? NULL : get_stmt(r);
+        sl->r_child = NULL;
+        if (i + 1 == count)
+            break;
+        sl->r_child = (st_list*) ast_alloc(sizeof(st_list), mem_st_list);
+        sl = sl->r_child;
+    }
+    return head;
+}
+
+bool read_ast_bin(const char* data, size_t size, parsed_program& program) {
+    ast_reader r;
+    r.pos = (const unsigned char*) data;
+    r.end = r.pos + size;
+    r.bad = false;
+    r.depth = 0;
+
+    if (size < sizeof(ast_bin_magic) || memcmp(data, ast_bin_magic, sizeof(ast_bin_magic)) != 0)
+        return false;
+    r.pos += sizeof(ast_bin_magic);
+    if (get_varint(r) != (unsigned long long) ast_bin_version)
+        return false;
+    program.syntax_error = get_varint(r) & 1;
+
+    unsigned long long count = get_varint(r);
+    if (count > (unsigned long long) (r.end - r.pos))
+        return false;
+    for (unsigned long long i = 0; i < count && !r.bad; i++) {
+        unsigned long long length = get_varint(r);
+        if (length > (unsigned long long) (r.end - r.pos))
+            return false;
+        r.strings.push_back(string_view((const char*) r.pos, length));
+        r.pos += length;
+    }
+
+    program.semantics = semantic_state();
+    get_bits(r, program.semantics.do_has_check);
+    get_bits(r, program.semantics.check_in_do);
+
+    ast_reset();
+    program.root = get_list(r);
+    return !r.bad && r.pos == r.end;
+}
+
+bool load_ast_bin(const char* path, parsed_program& program, ostream& diag) {
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) < 0) {
+        diag << path << ": " << strerror(errno) << endl;
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+
+    // mmap refuses an empty file, which is not an AST file either
+    void* data = info.st_size > 0 ? mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    bool ok = data != MAP_FAILED && read_ast_bin((const char*) data, info.st_size, program);
+    if (data != MAP_FAILED)
+        munmap(data, info.st_size);
+    if (!ok)
+        diag << path << ": not an AST file of version " << ast_bin_version << endl;
+    return ok;
+}
@@ -0,0 +1,43 @@
+#ifndef __ASTBIN_H
+#define __ASTBIN_H
+
+#include <iostream>
+#include <cstddef>
+#include "parse.h"
+
+/*
+ * binary AST file: what the front end produced (parse_program), saved so
+ * later stages can skip scanning and parsing (parse --emit-ast / --from-ast)
+ *
+ * All numbers are unsigned LEB128 varints, 7 bits per byte, low bits first.
+ *
+ *   file     := "CAST" version flags strings bits(do) bits(check) list
+ *   version  := 2
+ *   flags    := bit 0: the program had a syntax error
+ *   strings  := count { length bytes }         every id, literal and operator name once
+ *   bits(x)  := count { byte }                 semantic_state, 8 per byte, low bit first
+ *   list     := count { stmt }                 the st_list nodes, the last one is empty
+ *   stmt     := 0                              node without a statement
+ *             | tag line name [expr] [list]    tag = (type + 1) << 2 | has rel << 1 | has sl
+ *   expr     := tag name [expr] [expr]         tag = (type + 1) << 2 | has l_child << 1 | has r_child
+ *
+ * name is an index into strings. An expression node takes 2 bytes while there
+ * are at most 128 distinct names, a statement one or two more for its line;
+ * the file is read straight from a mapping of it, in one pass, into the arena
+ * of the reading thread. A node must have the children the parser gives its
+ * type, e.g. an if both rel and sl, an id neither.
+ */
+const int ast_bin_version = 2;     // 2: statements keep their line
+
+// nodes nested deeper are refused, about as deep as printing and compiling recurse
+const int ast_bin_max_depth = 25000;
+
+void write_ast_bin(const parsed_program& program, std::ostream& out);
+
+// false if data is not a well formed file of this version
+bool read_ast_bin(const char* data, size_t size, parsed_program& program);
+
+// maps the file and reads it; false with a message on diag if that fails
+bool load_ast_bin(const char* path, parsed_program& program, std::ostream& diag);
+
+#endif
@@ -0,0 +1,205 @@
+#include "batch.h"
+#include "calc.h"
+#include "pool.h"
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+// the table at the end of the translation unit, as the C declares it
+struct batch_entry {
+    const char* name;
+    int (*run)(void);
+};
+
+string batch_name(const string& path) {
+    size_t slash = path.rfind('/');
+    string name = path.substr(slash == string::npos ? 0 : slash + 1);
+    size_t dot = name.rfind('.');
+    if (dot != string::npos && dot > 0)
+        name.erase(dot);
+    for (size_t i = 0; i < name.size(); i++)
+        if (!isalnum((unsigned char) name[i]) && name[i] != '_')
+            name[i] = '_';
+    return name;
+}
+
+bool write_batch(const vector<batch_program>& programs, const compile_options& options, ostream& c, ostream& diag) {
+    if (options.profile) {
+        diag << "--batch: no --profile, its counters are the program's own" << endl;
+        return false;
+    }
+    set<string> names;
+    for (size_t i = 0; i < programs.size(); i++) {
+        if (programs[i].name.empty() || !names.insert(programs[i].name).second) {
+            diag << "--batch: two programs named " << programs[i].name << endl;
+            return false;
+        }
+    }
+
+    // each program on its own, one thread apiece under --jobs
+    vector<calc::CompileResult> results(programs.size());
+    parallel_for(programs.size(), options.jobs, [&](int i) {
+        compile_options opts = options;
+        opts.jobs = 1;
+        opts.function = "calc_program_" + programs[i].name;
+        results[i] = calc::compile(programs[i].source, opts);
+    });
+    bool ok = true;
+    for (size_t i = 0; i < programs.size(); i++) {
+        if (results[i].ok)
+            continue;
+        diag << programs[i].name << ":" << endl << results[i].diagnostics << results[i].report;
+        ok = false;
+    }
+    if (!ok)
+        return false;
+
+    compile_batch_prelude(options, c);
+    for (size_t i = 0; i < programs.size(); i++)
+        c << results[i].code << endl << endl;
+    c << "struct calc_program {" << endl;
+    c << "const char* name;" << endl;
+    c << "int (*run)(void);" << endl;
+    c << "};" << endl << endl;
+    c << "const struct calc_program calc_programs[] = {" << endl;
+    for (size_t i = 0; i < programs.size(); i++)
+        c << "{\"" << programs[i].name << "\", calc_program_" << programs[i].name << "}," << endl;
+    c << "};" << endl;
+    c << "const int calc_program_count = " << programs.size() << ";" << endl;
+    return true;
+}
+
+// FNV-1a, 64 bits
+static uint64_t content_hash(const string& text) {
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < text.size(); i++) {
+        h ^= (unsigned char) text[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static bool copy_file(const string& from, const string& to) {
+    ifstream in(from, ios::binary);
+    ofstream out(to, ios::binary);
+    out << in.rdbuf();
+    return in && out;
+}
+
+// runs the command without a shell, so nothing in the paths is interpreted; true if it exits 0
+static bool run_command(const vector<string>& args) {
+    vector<char*> argv;
+    for (size_t i = 0; i < args.size(); i++)
+        argv.push_back((char*) args[i].c_str());
+    argv.push_back(NULL);
+
+    pid_t child = fork();
+    if (child < 0)
+        return false;
+    if (child == 0) {
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+    int status;
+    while (waitpid(child, &status, 0) < 0)
+        if (errno != EINTR)
+            return false;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+bool build_batch(const string& c, const compile_options& options, const string& library, bool& cached, ostream& diag) {
+    vector<string> args = {"gcc", "-O2", "-shared", "-fPIC"};
+    if (options.openmp)
+        args.push_back("-fopenmp");
+    string command;
+    for (size_t i = 0; i < args.size(); i++)
+        command += (i ? " " : "") + args[i];
+    const char* dir = getenv("CALC_CACHE");
+    string cache = dir && *dir ? dir : "calc-cache";
+    // gcc would take a file name starting with - for an option
+    if (cache[0] == '-')
+        cache = "./" + cache;
+    mkdir(cache.c_str(), 0777);
+
+    char hash[17];
+    snprintf(hash, sizeof hash, "%016llx", (unsigned long long) content_hash(command + "\n" + c));
+    string object = cache + "/" + hash + ".so";
+    cached = access(object.c_str(), R_OK) == 0;
+    if (!cached) {
+        // under names of this process until done, another may be building the same one
+        string pid = "." + to_string(getpid());
+        string source = cache + "/" + hash + pid + ".c";
+        ofstream out(source);
+        out << c;
+        out.close();
+        if (!out) {
+            diag << source << ": cannot write" << endl;
+            return false;
+        }
+        args.push_back("-o");
+        args.push_back(object + pid);
+        args.push_back(source);
+        bool built = run_command(args);
+        remove(source.c_str());
+        if (!built || rename((object + pid).c_str(), object.c_str()) != 0) {
+            remove((object + pid).c_str());
+            diag << "--batch: gcc failed" << endl;
+            return false;
+        }
+    }
+
+    // a running --run keeps the library it opened
+    string temporary = library + ".tmp";
+    if (!copy_file(object, temporary) || rename(temporary.c_str(), library.c_str()) != 0) {
+        remove(temporary.c_str());
+        diag << library << ": cannot write" << endl;
+        return false;
+    }
+    return true;
+}
+
+int run_batch(const string& library, const vector<string>& names, ostream& diag) {
+    // a name without a slash would be looked up on the library path
+    string path = library.find('/') == string::npos ? "./" + library : library;
+    void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        diag << dlerror() << endl;
+        return 1;
+    }
+    const batch_entry* table = (const batch_entry*) dlsym(handle, "calc_programs");
+    const int* count = (const int*) dlsym(handle, "calc_program_count");
+    if (!table || !count) {
+        diag << library << ": not built by --batch" << endl;
+        return 1;
+    }
+
+    vector<const batch_entry*> order;
+    for (int i = 0; names.empty() && i < *count; i++)
+        order.push_back(&table[i]);
+    for (size_t i = 0; i < names.size(); i++) {
+        int found = 0;
+        while (found < *count && names[i] != table[found].name)
+            found++;
+        if (found == *count) {
+            diag << library << ": no program " << names[i] << endl;
+            return 1;
+        }
+        order.push_back(&table[found]);
+    }
+
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i]->run();
+        fflush(stdout);
+    }
+    return 0;
+}
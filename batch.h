@@ -0,0 +1,46 @@
+#ifndef __BATCH_H
+#define __BATCH_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "compile.h"
+
+/*
+ * batch native build: many programs, one gcc
+ *
+ *   parse [options] --batch=lib.so a.txt b.txt ...     builds lib.so
+ *   parse --run=lib.so [a b ...]                       runs programs in it
+ *
+ * every program becomes a static function calc_program_<name> (name: the
+ * file's, without directory and extension) of one translation unit with the
+ * runtime in front once, and a table calc_programs of names and functions
+ * behind; gcc makes that a shared object, which --run dlopens and calls
+ * the programs of by name, in order on the same stdin and stdout, all of
+ * them when no name is given
+ *
+ * the shared object is kept in $CALC_CACHE (calc-cache by default) under
+ * a hash of the C and the gcc command line: the same programs with the same
+ * options are not compiled again
+ */
+
+struct batch_program {
+    std::string name;
+    std::string source;
+};
+
+// "dir/test21.txt" is test21, anything but letters, digits and _ in it turns into _
+std::string batch_name(const std::string& path);
+
+// the translation unit, false (and what went wrong on diag) when a program does not compile
+bool write_batch(const std::vector<batch_program>& programs, const compile_options& options,
+                 std::ostream& c, std::ostream& diag);
+
+// library from the cache, gcc builds it first when it is not there; cached tells which
+bool build_batch(const std::string& c, const compile_options& options, const std::string& library,
+                 bool& cached, std::ostream& diag);
+
+// exit status, 1 when the library or a program cannot be found
+int run_batch(const std::string& library, const std::vector<std::string>& names, std::ostream& diag);
+
+#endif
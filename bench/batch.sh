@@ -0,0 +1,44 @@
+#!/bin/bash
+# Native build of many programs: parse, gcc and run each one on its own
+# against one --batch shared object run by --run, built and from the cache.
+#
+#   bench/batch.sh <program> <input> <copies>
+#
+# the copies of the program differ by a write of their number at the end so
+# none is the same as another; <input> is fed to every one, it is a file
+# when one exists by that name. Each way is timed once.
+
+set -e
+
+program=$1
+input=$2
+copies=$3
+dir=bench_batch
+trap 'rm -rf $dir' EXIT
+rm -rf $dir
+mkdir -p $dir/programs
+export CALC_CACHE=$dir/cache
+
+for i in $(seq $copies); do
+    (cat $program; echo "write $i") > $dir/programs/p$i.txt
+done
+feed() {
+    if [ -f "$input" ]; then cat "$input"; else echo "$input"; fi
+}
+
+timed() {
+    start=$(date +%s%N)
+    eval "$2" > /dev/null
+    end=$(date +%s%N)
+    printf "%-36s %8d ms\n" "$1" $(( (end - start) / 1000000 ))
+}
+
+timed "parse, gcc -O2, run each" \
+    'for f in $dir/programs/*.txt; do ./parse < $f > /dev/null && gcc -O2 -o $dir/a.out test.c && feed | $dir/a.out; done'
+timed "--batch, --run each" \
+    './parse --batch=$dir/lib.so $dir/programs/*.txt && for i in $(seq $copies); do feed | ./parse --run=$dir/lib.so p$i; done'
+timed "--batch from the cache, --run each" \
+    './parse --batch=$dir/lib.so $dir/programs/*.txt 2> /dev/null && for i in $(seq $copies); do feed | ./parse --run=$dir/lib.so p$i; done'
+timed "--batch from the cache, --run all" \
+    './parse --batch=$dir/lib.so $dir/programs/*.txt 2> /dev/null && for i in $(seq $copies); do feed; done | ./parse --run=$dir/lib.so'
+rm -f test.c
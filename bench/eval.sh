@@ -0,0 +1,37 @@
+#!/bin/bash
+# Time to first output of one calculator program: run by parse --eval against
+# translated, compiled by gcc and run; every path starts from the program text.
+#
+#   bench/eval.sh <program> <input>
+#
+# <input> is fed to the program's stdin, it is a file when one exists by that name.
+# the generated program and the evaluator both buffer their output, for a short
+# run the first byte comes at exit. Best of 3.
+
+set -e
+
+program=$1
+input=$2
+
+feed() {
+    if [ -f "$input" ]; then cat "$input"; else echo "$input"; fi
+}
+
+first_output() {
+    best=
+    for i in 1 2 3; do
+        start=$(date +%s%N)
+        feed | sh -c "$2" | head -c 1 > /dev/null
+        end=$(date +%s%N)
+        ms=$(( (end - start) / 1000000 ))
+        if [ -z "$best" ] || [ $ms -lt $best ]; then
+            best=$ms
+        fi
+    done
+    printf "%-24s %6d ms\n" "$1" $best
+}
+
+first_output "parse --eval" "./parse --eval=$program"
+first_output "parse, gcc -O0, run" "./parse < $program > /dev/null && gcc -O0 -o bench_eval test.c && ./bench_eval"
+first_output "parse, gcc -O2, run" "./parse < $program > /dev/null && gcc -O2 -o bench_eval test.c && ./bench_eval"
+rm -f bench_eval test.c
@@ -0,0 +1,58 @@
+/* Run time of a program in process: the closure evaluator (parse --eval),
+    with and without superinstructions, against the naive one that walks
+    the AST.
+
+    eval_bench <program> <input>
+    <input> is the program's stdin, a file when one exists by that name;
+    each evaluator runs 3 times and the best time is reported, conversion
+    of the AST included, output to /dev/null
+*/
+
+#include "../parse.h"
+#include "../eval.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        cerr << "usage: eval_bench <program> <input>" << endl;
+        return 1;
+    }
+    ifstream file(argv[1]);
+    ostringstream text, diag;
+    text << file.rdbuf();
+    compile_options options;
+    parsed_program program;
+    parse_program(text.str(), diag, options, program);
+
+    FILE* out = fopen("/dev/null", "w");
+    const char* names[] = {"naive", "closures", "fused"};
+    eval_options unfused;
+    unfused.fuse = false;
+    for (int i = 0; i < 3; i++) {
+        double best = 0;
+        for (int run = 0; run < 3; run++) {
+            FILE* in = fopen(argv[2], "r");
+            if (!in)
+                in = fmemopen(argv[2], strlen(argv[2]), "r");
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            if (i == 0)
+                eval_program_naive(program.root, options, in, out, diag);
+            else
+                eval_program(program.root, options, in, out, diag, i == 1 ? unfused : eval_options());
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            if (run == 0 || ms < best)
+                best = ms;
+            fclose(in);
+        }
+        printf("%-10s %8.1f ms\n", names[i], best);
+    }
+    fclose(out);
+    return 0;
+}
@@ -0,0 +1,60 @@
+#!/bin/bash
+# Input sets per second of one program: the plain C run once per set against
+# parse --lanes on all the sets at once, 1, 4 and 8 lanes.
+#
+#   bench/lanes.sh <program> <sets> <max>
+#
+# each set is a line of random numbers from 1 to <max>, one per read of the
+# program. The plain program runs on the first 1000 sets only, a process
+# each; the lanes on the first 1000 must write what it wrote. Each --lanes
+# run is the best wall time of 3, with the speedup over --lanes=1.
+
+set -e
+
+program=$1
+sets=$2
+max=$3
+trap 'rm -f bench_run bench_lanes.in bench_lanes.plain bench_lanes.out' EXIT
+
+reads=$(grep -c "read" $program)
+awk -v sets=$sets -v reads=$reads -v max=$max 'BEGIN {
+    srand(36);
+    for (i = 0; i < sets; i++) {
+        line = "";
+        for (j = 0; j < reads; j++)
+            line = line (j ? " " : "") int(1 + rand() * max);
+        print line;
+    }
+}' > bench_lanes.in
+
+sample=$(( sets < 1000 ? sets : 1000 ))
+./parse < $program > /dev/null
+gcc -O2 -o bench_run test.c
+start=$(date +%s%N)
+head -n $sample bench_lanes.in | while IFS= read -r line; do
+    echo "$line" | ./bench_run | tr '\n' ' ' | sed 's/ $//'
+    echo
+done > bench_lanes.plain
+end=$(date +%s%N)
+ms=$(( (end - start) / 1000000 ))
+printf "%-24s %10.0f sets/s\n" "plain, a process a set" $(echo "$sample $ms" | awk '{ print $1 * 1000 / ($2 > 0 ? $2 : 1) }')
+
+for lanes in 1 4 8; do
+    ./parse --lanes=$lanes < $program > /dev/null
+    gcc -O2 -o bench_run test.c
+    best=
+    for i in 1 2 3; do
+        start=$(date +%s%N)
+        ./bench_run < bench_lanes.in > bench_lanes.out
+        end=$(date +%s%N)
+        ms=$(( (end - start) / 1000000 ))
+        if [ -z "$best" ] || [ $ms -lt $best ]; then
+            best=$ms
+        fi
+    done
+    head -n $sample bench_lanes.out | cmp -s - bench_lanes.plain || { echo "--lanes=$lanes writes something else" >&2; exit 1; }
+    [ $lanes -eq 1 ] && scalar=$best
+    printf "%-24s %10.0f sets/s  %5.2fx\n" "--lanes=$lanes" \
+        $(echo "$sets $best" | awk '{ print $1 * 1000 / ($2 > 0 ? $2 : 1) }') \
+        $(echo "$scalar $best" | awk '{ printf "%.2f", $1 / ($2 > 0 ? $2 : 1) }')
+done
@@ -0,0 +1,45 @@
+#!/bin/bash
+# Time the C that parse --openmp generates for one program on 1, 2, 4 and 8 threads.
+#
+#   bench/omp.sh <program> <input>
+#
+# <input> is fed to the program's stdin, it is a file when one exists by that name.
+# the sequential C comes first, each run is the best wall time of 3, with the
+# speedup over the sequential one.
+
+set -e
+
+program=$1
+input=$2
+
+best_of_3() {
+    best=
+    for i in 1 2 3; do
+        start=$(date +%s%N)
+        if [ -f "$input" ]; then
+            "$@" < "$input" > /dev/null
+        else
+            echo "$input" | "$@" > /dev/null
+        fi
+        end=$(date +%s%N)
+        ms=$(( (end - start) / 1000000 ))
+        if [ -z "$best" ] || [ $ms -lt $best ]; then
+            best=$ms
+        fi
+    done
+}
+
+./parse < $program > /dev/null
+gcc -O2 -o bench_run test.c
+best_of_3 ./bench_run
+sequential=$best
+printf "%-24s %6d ms\n" "sequential" $sequential
+
+./parse --openmp < $program > /dev/null
+gcc -O2 -fopenmp -o bench_run test.c
+for threads in 1 2 4 8; do
+    best_of_3 env OMP_NUM_THREADS=$threads ./bench_run
+    printf "%-24s %6d ms  %5.2fx\n" "--openmp $threads threads" $best \
+        $(echo "$sequential $best" | awk '{ printf "%.2f", $1 / ($2 > 0 ? $2 : 1) }')
+done
+rm -f bench_run
@@ -0,0 +1,119 @@
+/* Hardware counters of the front end and the C emitter, phase by phase.
+
+    perf_bench <program> <megabytes>
+    repeats the program until the text is at least that big, then runs the
+    phases one after the other on one thread, each inside perf_collector
+    (perfcount.h): scan (scan() up to eof), parse (scanner included, it is
+    lazy), print AST, ranges, compile (given the ranges) and both of the last
+    in the one walk translate uses (fused). Every counter is
+    reported per input MB and per unit of the phase, tokens for scan, AST
+    nodes for the others; cycles and instructions give IPC. A counter the
+    machine does not give is "-", the reason is printed first.
+*/
+
+#include "../parse.h"
+#include "../perfcount.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+
+static long expression_nodes(bin_op* e) {
+    return e ? 1 + expression_nodes(e->l_child) + expression_nodes(e->r_child) : 0;
+}
+
+static long statement_nodes(st_list* list) {
+    long nodes = 0;
+    for (; list; list = list->r_child) {
+        nodes++;
+        if (st* s = list->l_child)
+            nodes += 1 + expression_nodes(s->rel) + statement_nodes(s->sl);
+    }
+    return nodes;
+}
+
+static void report(const char* phase, const perf_sample& sample, double megabytes, long units,
+                   const char* unit) {
+    printf("%-10s %8.1f ms  %10.0f %ss\n", phase, sample.wall * 1000, (double) units, unit);
+    for (int i = 0; i < perf_counters; i++) {
+        if (sample.value[i] < 0) {
+            printf("  %-14s %14s\n", perf_counter_names[i], "-");
+            continue;
+        }
+        printf("  %-14s %14.0f /MB %10.4g /%s\n", perf_counter_names[i], sample.value[i] / megabytes,
+               sample.value[i] / units, unit);
+    }
+    if (sample.value[perf_cycles] > 0 && sample.value[perf_instructions] >= 0)
+        printf("  %-14s %14.2f\n", "IPC", sample.value[perf_instructions] / sample.value[perf_cycles]);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        cerr << "usage: perf_bench <program> <megabytes>" << endl;
+        return 1;
+    }
+    ifstream file(argv[1]);
+    ostringstream program;
+    program << file.rdbuf() << "\n";
+
+    string text;
+    size_t size = atol(argv[2]) * 1024 * 1024;
+    while (text.size() < size)
+        text += program.str();
+    double megabytes = text.size() / 1e6;
+
+    perf_collector counters;
+    if (!counters.unavailable().empty())
+        printf("not counted, %s\n", counters.unavailable().c_str());
+    printf("%.0f MB of %s\n", megabytes, argv[1]);
+
+    ostringstream diag;
+    compile_options options;
+
+    counters.start();
+    scan_reset(text.data(), text.size(), diag);
+    long tokens = 0;
+    while (scan() != t_eof)
+        tokens++;
+    report("scan", counters.stop(), megabytes, tokens, "token");
+
+    parsed_program parsed;
+    counters.start();
+    parse_program(text, diag, options, parsed);
+    perf_sample parse = counters.stop();
+    if (parsed.syntax_error) {
+        cerr << argv[1] << " does not parse" << endl;
+        return 1;
+    }
+    long nodes = statement_nodes(parsed.root);
+    report("parse", parse, megabytes, nodes, "node");
+
+    ostringstream ast;
+    counters.start();
+    print_stmts(parsed.root, NULL, ast);
+    report("print AST", counters.stop(), megabytes, nodes, "node");
+
+    range_info ranges;
+    counters.start();
+    analyze_ranges(parsed.root, ranges);
+    report("ranges", counters.stop(), megabytes, nodes, "node");
+
+    ostringstream c;
+    counters.start();
+    compileToC(parsed.root, options, c, &ranges);
+    report("compile", counters.stop(), megabytes, nodes, "node");
+
+    // what translate does with a program that passes: print AST and compile in one walk (visit.h)
+    ostringstream fused_ast, fused_c;
+    counters.start();
+    compileToC(parsed.root, options, fused_c, &ranges, &fused_ast);
+    report("fused", counters.stop(), megabytes, nodes, "node");
+    if (fused_ast.str() != ast.str() || fused_c.str() != c.str()) {
+        cerr << "the fused walk does not print and compile the same" << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,38 @@
+#!/bin/bash
+# Wall time of parse with and without --pipeline on one big program, from a
+# file and from a writer that hands the text over in pieces.
+#
+#   bench/pipeline.sh <program> <copies>
+#
+# the program is repeated <copies> times, each run is the best of 3
+
+set -e
+
+program=$1
+copies=$2
+input=bench_pipeline.in
+trap 'rm -f $input' EXIT
+for i in $(seq $copies); do cat $program; done > $input
+
+best_of_3() {
+    best=
+    for i in 1 2 3; do
+        start=$(date +%s%N)
+        eval "$1" > /dev/null
+        end=$(date +%s%N)
+        ms=$(( (end - start) / 1000000 ))
+        if [ -z "$best" ] || [ $ms -lt $best ]; then
+            best=$ms
+        fi
+    done
+}
+
+# eight pieces with a pause after each, as from a slow disk or the network
+trickle="split -n 8 --filter='cat; sleep 0.05' $input"
+
+for flags in "" --pipeline; do
+    best_of_3 "./parse $flags < $input"
+    printf "%-12s from a file  %6d ms\n" "${flags:-default}" $best
+    best_of_3 "$trickle | ./parse $flags"
+    printf "%-12s trickled     %6d ms\n" "${flags:-default}" $best
+done
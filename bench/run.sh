@@ -0,0 +1,37 @@
+#!/bin/bash
+# Time the C generated for one calculator program under different parse flags.
+#
+#   bench/run.sh <program> <input> <flags>...
+#
+# <input> is fed to the program's stdin, it is a file when one exists by that name.
+# every <flags> argument is one configuration, "" is the default backend:
+#   bench/run.sh bench/primes.txt 3000 "" --ssa
+# each configuration is run 3 times and the best wall time is reported.
+
+set -e
+
+program=$1
+input=$2
+shift 2
+
+for flags in "$@"; do
+    ./parse $flags < $program > /dev/null
+    gcc -O2 -o bench_run test.c
+
+    best=
+    for i in 1 2 3; do
+        start=$(date +%s%N)
+        if [ -f "$input" ]; then
+            ./bench_run < "$input" > /dev/null
+        else
+            echo "$input" | ./bench_run > /dev/null
+        fi
+        end=$(date +%s%N)
+        ms=$(( (end - start) / 1000000 ))
+        if [ -z "$best" ] || [ $ms -lt $best ]; then
+            best=$ms
+        fi
+    done
+    printf "%-24s %6d ms\n" "${flags:-default}" $best
+done
+rm -f bench_run
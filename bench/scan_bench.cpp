@@ -0,0 +1,59 @@
+/* Scanner throughput, serial against scan_parallel.
+
+    scan_bench <program> <megabytes>
+    repeats the program until the text is at least that big, then scans it
+    with 1, 2, 4 and 8 jobs and reports MB/s; the parallel runs are timed up
+    to the token arrays (the time scan() then takes to hand them out is shown
+    apart), and must hand the parser the same number of tokens
+*/
+
+#include "../scan.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        cerr << "usage: scan_bench <program> <megabytes>" << endl;
+        return 1;
+    }
+    ifstream file(argv[1]);
+    ostringstream program;
+    program << file.rdbuf() << "\n";
+
+    string text;
+    size_t size = atol(argv[2]) * 1024 * 1024;
+    while (text.size() < size)
+        text += program.str();
+
+    ostringstream diag;
+    long expected = -1;
+    int jobs[] = {1, 2, 4, 8};
+    for (int i = 0; i < 4; i++) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        scan_reset(text.data(), text.size(), diag);
+        long tokens = 0;
+        if (jobs[i] > 1)
+            scan_parallel(jobs[i]);
+        double scanned = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        while (scan() != t_eof)
+            tokens++;
+        double total = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (jobs[i] == 1)
+            scanned = total;
+
+        if (expected < 0)
+            expected = tokens;
+        printf("jobs %d: %.0f MB in %.0f ms, %.0f MB/s, replay %.0f ms, %ld tokens%s\n", jobs[i],
+               text.size() / 1e6, scanned * 1000, text.size() / 1e6 / scanned, (total - scanned) * 1000,
+               tokens, tokens == expected ? "" : " MISMATCH");
+        if (tokens != expected)
+            return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,27 @@
+#!/bin/bash
+# Requests per second of `parse --serve` against forking parse once per program.
+#
+#   bench/serve.sh <program> <requests> <threads>
+
+set -e
+
+program=$1
+requests=$2
+threads=$3
+sock=bench_serve.sock
+
+rm -f $sock
+./parse --serve $sock --workers $threads 2> /dev/null &
+server=$!
+trap 'kill $server; rm -f $sock' EXIT
+while [ ! -S $sock ]; do sleep 0.1; done
+
+printf "%-10s " "server"
+./client $sock --bench $requests --threads $threads < $program
+
+# the same number of compilations, one process each, $threads at a time
+start=$(date +%s%N)
+seq $requests | xargs -P $threads -I{} sh -c "./parse < $program > /dev/null"
+end=$(date +%s%N)
+ms=$(( (end - start) / 1000000 ))
+printf "%-10s %d requests, %d processes at a time: %d ms, %d requests/sec\n" "fork" $requests $threads $ms $(( requests * 1000 / ms ))
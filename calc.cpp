@@ -0,0 +1,21 @@
+#include "calc.h"
+#include "parse.h"
+#include <sstream>
+
+using namespace std;
+
+namespace calc {
+
+CompileResult compile(string_view source, const Options& options) {
+    ostringstream ast, report, diagnostics, code;
+
+    CompileResult result;
+    result.ok = translate(source, ast, report, diagnostics, code, options);
+    result.ast = ast.str();
+    result.report = report.str();
+    result.diagnostics = diagnostics.str();
+    result.code = code.str();
+    return result;
+}
+
+}
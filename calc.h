@@ -0,0 +1,36 @@
+#ifndef __CALC_H
+#define __CALC_H
+
+#include <string>
+#include <string_view>
+#include "compile.h"
+
+/*
+ * libcalc: the transpiler as a library (make libcalc.a)
+ *
+ * compile() runs scanner, parser, semantic check and C generation on a
+ * program held in memory and hands everything back as strings; it touches
+ * no files and keeps its state per thread, so any number of threads may
+ * call it at once. Options the command line would refuse (options_conflict
+ * in parse.h) come back not ok with the reason in diagnostics; an id or
+ * literal longer than 99 characters is a syntax error like on the command line
+ */
+namespace calc {
+
+typedef compile_options Options;
+
+struct CompileResult {
+    bool ok;                    // passed the semantic check, code is set
+    std::string ast;            // the AST as parse prints it, empty after a syntax error
+    std::string report;         // the semantic check, one line per do and check
+    std::string diagnostics;    // syntax errors, what parse prints on stderr
+    std::string code;           // the C program
+
+    CompileResult() : ok(false) {}
+};
+
+CompileResult compile(std::string_view source, const Options& options = Options());
+
+}
+
+#endif
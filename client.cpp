@@ -0,0 +1,130 @@
+/* Client for `parse --serve`.
+
+    client <socket> [parse flags] < program
+        behaves like `parse [flags] < program`: AST and semantic report on
+        stdout, syntax errors on stderr, the C program in test.c
+
+    client <socket> --bench <requests> [--threads <n>] [parse flags] < program
+        sends the program <requests> times from <n> threads (default 4),
+        one connection per request, and reports requests per second
+*/
+
+#include "protocol.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace std;
+
+static const char* socket_path;
+
+// one round trip, false if the server could not be reached or the reply is broken
+static bool request(const string& text, string& out, string& diag, string& c) {
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return false;
+    if (connect(fd, (sockaddr*) &addr, sizeof(addr)) < 0 || !write_all(fd, text.data(), text.size())) {
+        close(fd);
+        return false;
+    }
+    shutdown(fd, SHUT_WR);
+
+    string reply;
+    bool ok = read_all(fd, reply);
+    close(fd);
+
+    size_t pos = 0;
+    string name;
+    ok = ok && read_section(reply, pos, name, out) && name == "out";
+    ok = ok && read_section(reply, pos, name, diag) && name == "diag";
+    ok = ok && read_section(reply, pos, name, c) && name == "c";
+    return ok;
+}
+
+static void bench(const string& text, int requests, int threads) {
+    atomic<int> next(0), failed(0), compiled(0);
+    vector<thread> clients;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i = 0; i < threads; i++) {
+        clients.push_back(thread([&]() {
+            string out, diag, c;
+            while (next++ < requests) {
+                if (!request(text, out, diag, c))
+                    failed++;
+                else if (!c.empty())
+                    compiled++;
+            }
+        }));
+    }
+    for (size_t i = 0; i < clients.size(); i++)
+        clients[i].join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    printf("%d requests, %d threads: %.0f ms, %.0f requests/sec (%d compiled, %d failed)\n",
+           requests, threads, seconds * 1000, requests / seconds, compiled.load(), failed.load());
+}
+
+static void usage() {
+    cerr << "usage: client <socket> [parse flags] < program" << endl;
+    cerr << "       client <socket> --bench <requests> [--threads <n>] [parse flags] < program" << endl;
+    exit (1);
+}
+
+int main (int argc, char* argv[]) {
+    if (argc < 2)
+        usage();
+    socket_path = argv[1];
+
+    int requests = 0;
+    int threads = 4;
+    string flags;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc)
+            requests = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else
+            flags += string(flags.empty() ? "" : " ") + argv[i];
+    }
+    if (threads < 1)
+        usage();
+
+    ostringstream program;
+    program << cin.rdbuf();
+    string text = flags + "\n" + program.str();
+
+    if (requests > 0) {
+        bench(text, requests, threads);
+        return 0;
+    }
+
+    string out, diag, c;
+    if (!request(text, out, diag, c)) {
+        perror(socket_path);
+        return 1;
+    }
+    cout << out;
+    cerr << diag;
+    if (!c.empty()) {
+        ofstream outputC("test.c");
+        outputC << c;
+    }
+    return 0;
+}
@@ -1,126 +1,889 @@
 #include "compile.h"
+#include "range.h"
+#include "visit.h"
+#include "lanes.h"
+#include "ssa.h"
+#include "loop.h"
+#include "depend.h"
+#include "scev.h"
 #include "debug.h"
+#include "pool.h"
+#include "feedback.h"
+#include "trace.h"
 #include <set>
+#include <map>
+#include <climits>
+#include <cstring>
 #include <string>
 #include <cstdlib>
-#include <fstream>
+#include <sstream>
+#include <vector>
 #include <unistd.h>
 
 using namespace std;
 
-void compile_program_ast(st_list* root);
-void compile_stmt_list(st_list *root);
+void compile_program_ast(st_list* root, ostream* ast);
+bool compile_walk(st_list* first, st_list* last, set<string>& names, ostream* ast);
+bool compile_parallel(st_list* root, set<string>& names, ostream* ast);
 void compile_relation(bin_op* root);
+void compile_ssa(st_list* root);
+void compile_closed_form_helpers();
+string relation_text(bin_op* root, const map<string, string>* names);
+string operation_text(bin_op* node, const string& l, const string& r);
 
-set<string> variables;
-ofstream outputC;
+/*
+ * --profile: every statement gets a counter, numbered in source order, that
+ * it bumps when it runs; a do also counts its iterations. The counters are
+ * static arrays, the report is written to stderr at exit, one statement per
+ * line: source line, statement, runs and, for a do, iterations
+ */
+struct profile_info {
+    map<const st*, int> index;
+    vector<const st*> order;
+};
 
-void compileToC(st_list* root)  {
-    outputC.open ("test.c");
-    compile_program_ast(root);
-    outputC.close();
+static void number_statements(st_list* sl, profile_info& info) {
+    for (; sl != NULL; sl = sl->r_child) {
+        if (!sl->l_child)
+            continue;
+        info.index[sl->l_child] = info.order.size();
+        info.order.push_back(sl->l_child);
+        if (sl->l_child->sl)
+            number_statements(sl->l_child->sl, info);
+    }
 }
 
-void parse_variable(st_list* root) {
-    if (!root)
+// per thread, the server compiles on several workers at once
+thread_local set<string> variables;
+thread_local const range_info* ranges;  // --jobs workers share the caller's
+thread_local const profile_info* profile;   // NULL without --profile, shared like ranges
+thread_local const profile_counts* feedback;    // NULL without --profile-use, shared too
+thread_local compile_options options;
+thread_local ostream* outputC;
+thread_local bool in_parallel_loop;    // inside an omp parallel for, no parallel loops in it
+
+void compileToC(st_list* root, const compile_options& opts, ostream& out, const range_info* analyzed,
+                ostream* ast)  {
+    range_info info;
+    if (!analyzed) {
+        trace_span span("ranges");
+        analyze_ranges(root, info);
+    }
+    if (opts.lanes) {
+        compile_lanes(root, opts, analyzed ? *analyzed : info, out, ast);
         return;
-    if (root->l_child) {
-        if (root->l_child->type == t_id || root->l_child->type == t_read) {
-            variables.insert(string(root->l_child->id));
-        }
-        else if (root->l_child->type == t_if || root->l_child->type == t_do) {
-            parse_variable(root->l_child->sl);
-        }
     }
-    parse_variable(root->r_child);
+    profile_info counters;
+    if (opts.profile)
+        number_statements(root, counters);
+    profile_counts measured;
+    if (!opts.profile_use.empty())
+        read_profile(opts.profile_use, root, measured);
+
+    options = opts;
+    outputC = &out;
+    ranges = analyzed ? analyzed : &info;
+    profile = opts.profile ? &counters : NULL;
+    feedback = opts.profile_use.empty() ? NULL : &measured;
+    variables.clear();
+    in_parallel_loop = false;
+    compile_program_ast(root, ast);
+}
+
+// every variable assigned or read into, declared in front of the statements
+class variable_collector : public ast_visitor<variable_collector> {
+public:
+    explicit variable_collector(set<string>& names) : names(names) {}
+    bool enter(st* statement) {
+        if (statement->type == t_id || statement->type == t_read)
+            names.insert(statement->id);
+        return statement->type == t_if || statement->type == t_do;
+    }
+private:
+    set<string>& names;
+};
+
+/*
+ * the C of the statements, a do or an if closed by leave once its body is
+ * written; the condition and the step of a for loop are in its head, the
+ * emitter stays quiet when the walk comes to them in the body
+ */
+class c_emitter : public ast_visitor<c_emitter> {
+public:
+    c_emitter() : closed_forms(false) {}
+    bool enter(st* statement);
+    void leave(st* statement);
+
+    bool closed_forms;      // a loop was replaced by its closed form, the helpers go in front
+private:
+    struct open_statement {
+        const st* quiet[2];     // check and step in a loop head
+        bool parallel;          // an omp loop, in an if of its own
+        uint64_t start;         // of a top-level statement, for --trace
+    };
+    bool opened(open_statement& statement);
+    void done(const st* statement, uint64_t start);
+
+    vector<open_statement> open;
+};
+
+// narrowest type holding every value the variable is assigned
+const char* variable_type(const string& name) {
+    map<string, range>::const_iterator found = ranges->variables.find(name);
+    if (found == ranges->variables.end())
+        return "int";
+    return range_c_type(found->second);
+}
+
+// expressions the analysis never reached (dead code) stay plain int
+bool fits_int(bin_op* node) {
+    map<const bin_op*, range>::const_iterator found = ranges->nodes.find(node);
+    return found == ranges->nodes.end() || range_fits(found->second, INT_MIN, INT_MAX);
+}
+
+bool may_overflow(bin_op* node) {
+    map<const bin_op*, range>::const_iterator found = ranges->nodes.find(node);
+    return found != ranges->nodes.end() && !range_bounded(found->second);
+}
+
+// some operation in node may overflow
+bool any_overflow(bin_op* node) {
+    if (node == NULL)
+        return false;
+    return may_overflow(node) || any_overflow(node->l_child) || any_overflow(node->r_child);
 }
 
-void compile_variables(st_list* root) {
-    parse_variable(root);
+void compile_variables() {
     for (set<string>::iterator it = variables.begin(); it != variables.end(); it++) {
-        outputC << "int " << *it << ";" << endl;
+        *outputC << variable_type(*it) << " " << *it << ";" << endl;
     }
 }
 
-void compile_program_ast(st_list* root) {
-    outputC << "#include <stdio.h>" << endl << endl;
-    outputC << "int main() {" << endl;
-    compile_variables(root);
-    compile_stmt_list(root);
-    outputC << endl <<  "return 0;";
-    outputC << endl << "}";
+/*
+ * I/O runtime of the generated program
+ *
+ * input is read in blocks and parsed by hand, output is formatted by hand
+ * into a block that is written when full and at exit; reads behave like
+ * scanf("%d"): at the end of input the variable keeps its value
+ */
+static const char* io_runtime = R"(static char calc_in[1 << 16];
+static size_t calc_in_len, calc_in_pos;
+static char calc_out[1 << 16];
+static size_t calc_out_len;
+
+static void calc_flush(void) {
+    fwrite(calc_out, 1, calc_out_len, stdout);
+    calc_out_len = 0;
+    fflush(stdout);
 }
 
-void compile_stmt_list(st_list *root) {
-    if (root->l_child != NULL) {
-        switch(root->l_child->type) {
-            case t_id:
-                outputC << root->l_child->id << " = ";
-                compile_relation(root->l_child->rel);
-                outputC << ";" << endl;
-                break;
-            case t_read:
-                outputC << "scanf(\"%d\", &" << root->l_child->id << ");" << endl;
-                break;
-            case t_write:
-                outputC << "printf(\"%d\\n\",";
-                compile_relation(root->l_child->rel);
-                outputC << ");" << endl;
-                break;
-            case t_do:
-                outputC << "while(1) {" << endl;
-                compile_stmt_list(root->l_child->sl);
-                outputC << "}" << endl;
-                break;
-            case t_if:
-                outputC << "if (";
-                compile_relation(root->l_child->rel);
-                outputC << ") {" << endl;
-                compile_stmt_list(root->l_child->sl);
-                outputC << "}" << endl;
-                break;
-            case t_check:
-                outputC << "if (!(";
-                compile_relation(root->l_child->rel);
-                outputC << ")) {" << endl;
-                outputC << "break;" << endl << "}" << endl;
-                break;
-            default:
-                cerr << "wrong type" << endl;
-        }
-        outputC << endl;
+static inline int calc_getc(void) {
+    if (calc_in_pos == calc_in_len) {
+        calc_in_len = fread(calc_in, 1, sizeof calc_in, stdin);
+        calc_in_pos = 0;
+        if (calc_in_len == 0)
+            return EOF;
     }
-    if (root->r_child != NULL)
-        compile_stmt_list(root->r_child);
+    return (unsigned char) calc_in[calc_in_pos++];
 }
 
-// prefix tree traversal
-void compile_relation(bin_op* root) {
-    if (root->l_child != NULL && root->r_child != NULL) {
-        outputC << " (";
+static int calc_read(int64_t* v) {
+    int c = calc_getc();
+    while (c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f')
+        c = calc_getc();
+    int negative = c == '-';
+    if (c == '-' || c == '+')
+        c = calc_getc();
+    if (c < '0' || c > '9')
+        return 0;
+    uint64_t n = 0;
+    do {
+        n = n * 10 + (c - '0');
+        c = calc_getc();
+    } while (c >= '0' && c <= '9');
+    if (c != EOF)
+        calc_in_pos--;
+    *v = negative ? (int64_t) -n : (int64_t) n;
+    return 1;
+}
+
+static inline void calc_read_int(int* v) {
+    int64_t n;
+    if (calc_read(&n))
+        *v = (int) n;
+}
+
+static inline void calc_read_int64(int64_t* v) {
+    calc_read(v);
+}
+
+static void calc_write(int64_t v) {
+    char digits[24];
+    int i = 0;
+    uint64_t n = v < 0 ? -(uint64_t) v : (uint64_t) v;
+    if (calc_out_len + sizeof digits > sizeof calc_out)
+        calc_flush();
+    if (v < 0)
+        calc_out[calc_out_len++] = '-';
+    do {
+        digits[i++] = '0' + n % 10;
+        n /= 10;
+    } while (n);
+    while (i)
+        calc_out[calc_out_len++] = digits[--i];
+    calc_out[calc_out_len++] = '\n';
+}
+
+)";
+
+void compile_read(const string& name, const char* type) {
+    bool wide = strcmp(type, "int64_t") == 0;
+    if (options.stdio)
+        *outputC << "scanf(\"%" << (wide ? "\" SCNd64" : "d\"") << ", &" << name << ");" << endl;
+    else
+        *outputC << (wide ? "calc_read_int64(&" : "calc_read_int(&") << name << ");" << endl;
+}
+
+// text is the C of the written expression
+void compile_write(bin_op* node, const string& text) {
+    if (!options.stdio)
+        *outputC << "calc_write(" << text << ");" << endl;
+    else if (fits_int(node))
+        *outputC << "printf(\"%d\\n\"," << text << ");" << endl;
+    else
+        *outputC << "printf(\"%\" PRId64 \"\\n\", (int64_t)" << text << ");" << endl;
+}
+
+void compile_profile_tables() {
+    size_t n = profile->order.size();
+    // an array of 0 elements is not C
+    size_t size = n > 0 ? n : 1;
+    *outputC << "static unsigned long long calc_hits[" << size << "], calc_iters[" << size << "];" << endl;
+    *outputC << "static const int calc_line[" << size << "] = {";
+    for (size_t i = 0; i < n; i++)
+        *outputC << (i ? ", " : "") << profile->order[i]->line;
+    *outputC << "};" << endl;
+    *outputC << "static const char* const calc_what[" << size << "] = {";
+    for (size_t i = 0; i < n; i++)
+        *outputC << (i ? ", " : "") << "\"" << statement_name(profile->order[i]->type) << "\"";
+    *outputC << "};" << endl << endl;
+
+    *outputC << "static void calc_profile_report(void) {" << endl;
+    *outputC << "fprintf(stderr, \"profile: line statement runs iterations\\n\");" << endl;
+    *outputC << "for (int i = 0; i < " << n << "; i++) {" << endl;
+    *outputC << "fprintf(stderr, \"%6d  %-6s %12llu\", calc_line[i], calc_what[i], calc_hits[i]);" << endl;
+    *outputC << "if (calc_what[i][0] == 'd')" << endl;
+    *outputC << "fprintf(stderr, \" %12llu\", calc_iters[i]);" << endl;
+    *outputC << "fputc('\\n', stderr);" << endl;
+    *outputC << "}" << endl;
+    *outputC << "}" << endl << endl;
+}
+
+// the counter of a statement, bumped where it runs
+string profile_hit(const st* statement) {
+    ostringstream hit;
+    hit << "calc_hits[" << profile->index.find(statement)->second << "]++";
+    return hit.str();
+}
+
+void compile_hit(const st* statement) {
+    if (profile)
+        *outputC << profile_hit(statement) << ";" << endl;
+}
+
+void compile_iteration(const st* loop) {
+    if (profile)
+        *outputC << "calc_iters[" << profile->index.find(loop)->second << "]++;" << endl;
+}
+
+/*
+ * --profile-use: branches the profile knows the way of are marked with
+ * __builtin_expect, a rarely taken if body is a cold label (gcc moves it
+ * out of the hot path) and a loop of many iterations per run is unrolled
+ */
+int branch_hint(const st* statement) {
+    return feedback ? expected_branch(*feedback, statement) : -1;
+}
+
+void compile_unroll(const st* loop) {
+    if (feedback && hot_loop(*feedback, loop))
+        *outputC << "#pragma GCC unroll 4" << endl;
+}
+
+// a check tested in a loop header still counts its runs, its rare exit makes the loop likely to go on
+void compile_condition(const st* check) {
+    if (profile)
+        *outputC << "(" << profile_hit(check) << ",";
+    if (branch_hint(check) == 0) {
+        *outputC << "__builtin_expect(!!(";
+        compile_relation(check->rel);
+        *outputC << "), 1)";
+    } else {
+        compile_relation(check->rel);
     }
+    if (profile)
+        *outputC << ")";
+}
+
+void compile_checked_helpers() {
+    *outputC << "static void calc_overflow(void) {" << endl;
+    *outputC << (options.stdio ? "fflush(stdout);" : "calc_flush();") << endl;
+    *outputC << "fputs(\"integer overflow\\n\", stderr);" << endl;
+    if (profile)
+        *outputC << "calc_profile_report();" << endl;
+    *outputC << "abort();" << endl;
+    *outputC << "}" << endl << endl;
 
-    if (root->l_child) {
-        compile_relation(root->l_child);
+    const char* ops[] = {"add", "sub", "mul"};
+    for (int i = 0; i < 3; i++) {
+        *outputC << "static inline int64_t calc_checked_" << ops[i] << "(int64_t a, int64_t b) {" << endl;
+        *outputC << "int64_t r;" << endl;
+        *outputC << "if (__builtin_" << ops[i] << "_overflow(a, b, &r)) calc_overflow();" << endl;
+        *outputC << "return r;" << endl;
+        *outputC << "}" << endl << endl;
     }
+}
 
-    if (root) {
-        if (root->type == t_id) {
-            outputC << root->name;
-        }
-        else if (root->type == t_literal) {
-            outputC << root->name;
-        }
-        else {
-            outputC << root->name;
+// includes, runtime and helpers, once in front of main or of a batch's functions
+void compile_prelude(bool closed_forms) {
+    *outputC << "#include <stdio.h>" << endl;
+    *outputC << "#include <stdlib.h>" << endl;
+    *outputC << "#include <inttypes.h>" << endl << endl;
+    if (!options.stdio)
+        *outputC << io_runtime;
+    if (profile)
+        compile_profile_tables();
+    if (options.checked)
+        compile_checked_helpers();
+    if (closed_forms)
+        compile_closed_form_helpers();
+}
+
+void compile_batch_prelude(const compile_options& opts, ostream& out) {
+    options = opts;
+    outputC = &out;
+    profile = NULL;
+    compile_prelude(opts.closed_forms);
+}
+
+/*
+ * the statements are written first, to a buffer, in the walk that collects
+ * the variables (and prints the AST when asked); what goes in front of them
+ * is only known once it is done
+ */
+void compile_program_ast(st_list* root, ostream* ast) {
+    bool function = !options.function.empty();
+    ostream* out = outputC;
+    output_buffer statements;
+    outputC = &statements;
+    bool closed_forms;
+    // the SSA form has no statements left to count, no loops left to run in parallel
+    bool ssa = options.ssa && !profile && !options.openmp;
+    if (ssa) {
+        if (ast)
+            print_stmts(root, NULL, *ast);
+        // it runs every loop, the closed form helpers would go unused
+        closed_forms = false;
+        compile_ssa(root);
+    } else if (options.jobs > 1) {
+        closed_forms = compile_parallel(root, variables, ast);
+    } else {
+        closed_forms = compile_walk(root, NULL, variables, ast);
+    }
+    outputC = out;
+
+    if (!function)
+        compile_prelude(closed_forms);
+    *outputC << (function ? "static int " + options.function + "(void)" : string("int main()")) << " {" << endl;
+    if (!options.stdio && !function)
+        *outputC << "atexit(calc_flush);" << endl;
+    if (profile)
+        *outputC << "atexit(calc_profile_report);" << endl;
+    if (!ssa)
+        compile_variables();
+    *outputC << statements.str();
+    // the next program of the batch reads on from here, what this one wrote goes out before it
+    if (!options.stdio && function)
+        *outputC << endl << "calc_flush();";
+    *outputC << endl <<  "return 0;";
+    *outputC << endl << "}";
+}
+
+// one walk: the variables into names, the C to outputC, the AST to ast when given; whether closed forms were used
+bool compile_walk(st_list* first, st_list* last, set<string>& names, ostream* ast) {
+    variable_collector collector(names);
+    c_emitter emitter;
+    if (ast) {
+        ast_printer printer(*ast);
+        fused_walk(first, last, printer, collector, emitter);
+    } else {
+        fused_walk(first, last, collector, emitter);
+    }
+    return emitter.closed_forms;
+}
+
+/*
+ * once the ranges are known a top-level statement compiles on its own, so
+ * runs of them are walked on --jobs threads into their own buffers and
+ * appended in order, the output is the same as compile_walk's
+ */
+bool compile_parallel(st_list* root, set<string>& names, ostream* ast) {
+    vector<stmt_range> chunks = split_stmt_list(root, options.jobs * 4);
+    vector<output_buffer> text(chunks.size());
+    vector<output_buffer> printed(ast ? chunks.size() : 0);
+    vector<set<string> > assigned(chunks.size());
+    vector<char> closed_forms(chunks.size());
+    vector<ostringstream> diag(chunks.size());
+    const range_info* shared = ranges;
+    const profile_info* counters = profile;
+    const profile_counts* measured = feedback;
+    compile_options opts = options;
+
+    parallel_for(chunks.size(), options.jobs, [&](int i) {
+        mem_scope scope(mem_compile);
+        trace_span span("compile chunk");
+        ranges = shared;
+        profile = counters;
+        feedback = measured;
+        options = opts;
+        outputC = &text[i];
+        diag_out = &diag[i];
+        closed_forms[i] = compile_walk(chunks[i].first, chunks[i].last, assigned[i], ast ? &printed[i] : NULL);
+    });
+    bool any = false;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        *outputC << text[i].str();
+        if (ast)
+            *ast << printed[i].str();
+        *diag_out << diag[i].str();
+        names.insert(assigned[i].begin(), assigned[i].end());
+        any = any || closed_forms[i];
+    }
+    return any;
+}
+
+// do check i < N ... i := i + c od  as  for (; i < N; i = i + c) { ... }, up to the body
+void compile_counted_loop(const st* statement, const counted_loop& loop) {
+    if (options.loop_hints) {
+        *outputC << "#pragma GCC ivdep" << endl;
+        *outputC << "#pragma GCC unroll 4" << endl;
+    } else {
+        compile_unroll(statement);
+    }
+    *outputC << "for (; ";
+    compile_condition(loop.check);
+    *outputC << "; ";
+    if (profile)
+        *outputC << profile_hit(loop.step) << ", ";
+    *outputC << loop.step->id << " =";
+    compile_relation(loop.step->rel);
+    *outputC << ") {" << endl;
+    compile_iteration(statement);
+}
+
+/*
+ * --openmp: a counted loop with independent iterations (depend.h) as the
+ * canonical loop OpenMP splits over threads
+ *
+ *   if (i < N) {
+ *   int calc_from = i;
+ *   #pragma omp parallel for lastprivate(i, t) reduction(+:s)
+ *   for (i = calc_from; i < N; i += c) { ... }
+ *   }
+ *
+ * compile_parallel_loop writes it up to the body, in_parallel_loop is set
+ * until the emitter closes it
+ * lastprivate leaves i with its value after the last step, as the sequential
+ * loop does, and the privates with what the last iteration assigned; the if
+ * keeps them all as they were when there is no iteration at all
+ */
+bool parallel_loop(st* statement, loop_dependences& deps) {
+    if (!options.openmp || in_parallel_loop || profile || !analyze_dependences(statement, *ranges, deps))
+        return false;
+    // an overflow check on the step is no canonical loop, and the threads add up their sums unchecked
+    if (options.checked) {
+        if (may_overflow(deps.shape.step->rel))
+            return false;
+        for (set<string>::iterator it = deps.reductions.begin(); it != deps.reductions.end(); it++)
+            if (!range_bounded(ranges->variables.find(*it)->second))
+                return false;
+    }
+    return true;
+}
+
+static void compile_names(const char* clause, const set<string>& names, const char* more) {
+    if (names.empty() && !more)
+        return;
+    *outputC << " " << clause << (more ? more : "");
+    const char* separator = more ? ", " : "";
+    for (set<string>::const_iterator it = names.begin(); it != names.end(); it++) {
+        *outputC << separator << *it;
+        separator = ", ";
+    }
+    *outputC << ")";
+}
+
+void compile_parallel_loop(const loop_dependences& deps) {
+    const counted_loop& loop = deps.shape;
+    string test = string(loop.var) + (loop.up ? " <" : " >") + (loop.inclusive ? "= " : " ")
+                  + relation_text(loop.bound, NULL);
+
+    *outputC << "if (" << test << ") {" << endl;
+    *outputC << variable_type(loop.var) << " calc_from = " << loop.var << ";" << endl;
+    *outputC << "#pragma omp parallel for";
+    compile_names("lastprivate(", deps.privates, loop.var);
+    compile_names("reduction(+:", deps.reductions, NULL);
+    // nested loops make iterations of unequal cost, threads take shrinking blocks as they come free
+    if (deps.nested)
+        *outputC << " schedule(guided)";
+    *outputC << endl;
+    *outputC << "for (" << loop.var << " = calc_from; " << test << "; " << loop.var << (loop.up ? " += " : " -= ")
+             << loop.stride << ") {" << endl;
+    in_parallel_loop = true;
+}
+
+/*
+ * a counted loop that leaves what scev.h solves for is replaced by it
+ *
+ *   {
+ *   __int128 calc_span = (__int128)(N) - i - 1;
+ *   uint64_t calc_trips = calc_span < 0 ? 0 : (uint64_t)(calc_span / c) + 1;
+ *   uint64_t calc_s = (uint64_t)s + UINT64_C(3) * calc_trips + ...;
+ *   uint64_t calc_i = (uint64_t)i + UINT64_C(c) * calc_trips;
+ *   s = calc_s;
+ *   i = calc_i;
+ *   }
+ *
+ * every final value is worked out from the values at the start before any
+ * is stored, on uint64_t where the adds and multiplies wrap as the loop's
+ * would; the store keeps the low bits, the loop's result in the variable's
+ * type. Not under --profile, the counters would miss the iterations, nor
+ * under --checked where anything in the body may overflow, which has to trap
+ */
+bool closed_form_loop(st* statement, scev_loop& solved) {
+    if (!options.closed_forms || profile || !solve_loop(statement, solved))
+        return false;
+    if (options.checked) {
+        for (st_list* sl = solved.shape.first; sl != solved.shape.last; sl = sl->r_child)
+            if (sl->l_child && any_overflow(sl->l_child->rel))
+                return false;
+        if (any_overflow(solved.shape.step->rel))
+            return false;
+    }
+    return true;
+}
+
+void compile_closed_form_helpers() {
+    // C(k, m), m <= 4, exact modulo 2^64: m! is divided out of the factors before they are multiplied
+    *outputC << "static inline uint64_t calc_choose(uint64_t k, int m) {" << endl;
+    *outputC << "uint64_t f[4];" << endl;
+    *outputC << "int twos = m == 4 ? 3 : m >= 2;" << endl;
+    *outputC << "if (k < (uint64_t) m) return 0;" << endl;
+    *outputC << "for (int i = 0; i < m; i++) f[i] = k - i;" << endl;
+    *outputC << "for (int i = 0; i < m && m >= 3; i++) if (f[i] % 3 == 0) { f[i] /= 3; break; }" << endl;
+    *outputC << "for (int i = 0; i < m; i++) while (twos && f[i] % 2 == 0) { f[i] /= 2; twos--; }" << endl;
+    *outputC << "uint64_t r = 1;" << endl;
+    *outputC << "for (int i = 0; i < m; i++) r *= f[i];" << endl;
+    *outputC << "return r;" << endl;
+    *outputC << "}" << endl << endl;
+
+    *outputC << "static inline uint64_t calc_power(uint64_t x, uint64_t k) {" << endl;
+    *outputC << "uint64_t r = 1;" << endl;
+    *outputC << "for (; k; k >>= 1, x *= x) if (k & 1) r *= x;" << endl;
+    *outputC << "return r;" << endl;
+    *outputC << "}" << endl << endl;
+}
+
+// sum of constants times products of start values, as uint64_t
+string coefficient_text(const scev_coefficient& c) {
+    string text;
+    for (scev_coefficient::const_iterator t = c.begin(); t != c.end(); t++) {
+        ostringstream term;
+        const char* times = "";
+        if (t->second != 1 || t->first.empty()) {
+            term << "UINT64_C(" << t->second << ")";
+            times = " * ";
         }
+        for (size_t i = 0; i < t->first.size(); i++, times = " * ")
+            term << times << "(uint64_t)" << t->first[i];
+        text += (text.empty() ? "" : " + ") + term.str();
+    }
+    return text.empty() ? "0" : text;
+}
+
+// in the number of iterations, calc_trips
+string polynomial_text(const scev_poly& p) {
+    string text;
+    for (size_t m = 0; m < p.size(); m++) {
+        if (p[m].empty())
+            continue;
+        string c = coefficient_text(p[m]);
+        if (m > 0 && p[m].size() > 1)
+            c = "(" + c + ")";
+        ostringstream term;
+        if (m == 0)
+            term << c;
+        else
+            term << (c == "UINT64_C(1)" ? "" : c + " * ");
+        if (m == 1)
+            term << "calc_trips";
+        else if (m > 1)
+            term << "calc_choose(calc_trips, " << m << ")";
+        text += (text.empty() ? "" : " + ") + term.str();
+    }
+    return text.empty() ? "0" : text;
+}
+
+void compile_closed_form(const scev_loop& solved) {
+    const counted_loop& loop = solved.shape;
+    string bound = relation_text(loop.bound, NULL);
+    const char* strict = loop.inclusive ? "" : " - 1";
+
+    *outputC << "{" << endl;
+    if (loop.up)
+        *outputC << "__int128 calc_span = (__int128)(" << bound << ") - " << loop.var << strict << ";" << endl;
+    else
+        *outputC << "__int128 calc_span = (__int128)" << loop.var << " - (" << bound << ")" << strict << ";" << endl;
+    *outputC << "uint64_t calc_trips = calc_span < 0 ? 0 : (uint64_t)(calc_span / " << loop.stride << ") + 1;" << endl;
+    for (size_t i = 0; i < solved.finals.size(); i++) {
+        const scev_final& f = solved.finals[i];
+        *outputC << "uint64_t calc_" << f.var << " = ";
+        if (f.kind == e_polynomial)
+            *outputC << polynomial_text(f.value);
+        else if (f.kind == e_geometric)
+            *outputC << "(uint64_t)" << f.var << " * calc_power(" << coefficient_text(f.ratio) << ", calc_trips)";
+        else
+            *outputC << "calc_trips ? " << polynomial_text(f.value) << " : (uint64_t)" << f.var;
+        *outputC << ";" << endl;
     }
+    for (size_t i = 0; i < solved.finals.size(); i++)
+        *outputC << solved.finals[i].var << " = calc_" << solved.finals[i].var << ";" << endl;
+    *outputC << "}" << endl;
+}
 
-    if (root->r_child) {
-        compile_relation(root->r_child);
+bool c_emitter::enter(st* statement) {
+    if (!open.empty() && (statement == open.back().quiet[0] || statement == open.back().quiet[1]))
+        return false;
+    open_statement head = {{NULL, NULL}, false, open.empty() && trace_enabled ? trace_now() : 0};
+    st_list* body;
+    counted_loop loop;
+    loop_dependences deps;
+    scev_loop solved;
+    int hint;
+
+    compile_hit(statement);
+    switch(statement->type) {
+        case t_id:
+            *outputC << statement->id << " = ";
+            compile_relation(statement->rel);
+            *outputC << ";" << endl;
+            break;
+        case t_read:
+            compile_read(statement->id, variable_type(statement->id));
+            break;
+        case t_write:
+            compile_write(statement->rel, relation_text(statement->rel, NULL));
+            break;
+        case t_do:
+            if (closed_form_loop(statement, solved)) {
+                compile_closed_form(solved);
+                closed_forms = true;
+                break;
+            }
+            if (parallel_loop(statement, deps)) {
+                compile_parallel_loop(deps);
+                head.quiet[0] = deps.shape.check;
+                head.quiet[1] = deps.shape.step;
+                head.parallel = true;
+                return opened(head);
+            }
+            if (recognize_counted_loop(statement, loop)) {
+                compile_counted_loop(statement, loop);
+                head.quiet[0] = loop.check;
+                head.quiet[1] = loop.step;
+                return opened(head);
+            }
+            compile_unroll(statement);
+            body = statement->sl;
+            // a leading check is the loop condition
+            if (body->l_child && body->l_child->type == t_check) {
+                *outputC << "while (";
+                compile_condition(body->l_child);
+                *outputC << ") {" << endl;
+                head.quiet[0] = body->l_child;
+            } else {
+                *outputC << "while(1) {" << endl;
+            }
+            compile_iteration(statement);
+            return opened(head);
+        case t_if:
+            hint = branch_hint(statement);
+            *outputC << "if (" << (hint < 0 ? "" : "__builtin_expect(!!(");
+            compile_relation(statement->rel);
+            if (hint >= 0)
+                *outputC << "), " << hint << ")";
+            *outputC << ") {" << endl;
+            // a local label, every cold body may have one
+            if (hint == 0)
+                *outputC << "__label__ calc_cold;" << endl << "calc_cold: __attribute__((cold, unused));" << endl;
+            return opened(head);
+        case t_check:
+            hint = branch_hint(statement);
+            *outputC << (hint == 0 ? "if (__builtin_expect(!(" : "if (!(");
+            compile_relation(statement->rel);
+            *outputC << (hint == 0 ? "), 0)) {" : ")) {") << endl;
+            *outputC << "break;" << endl << "}" << endl;
+            break;
+        default:
+            *diag_out << "wrong type" << endl;
     }
+    done(statement, head.start);
+    return false;
+}
+
+void c_emitter::leave(st* statement) {
+    open_statement head = open.back();
+    open.pop_back();
+    if (head.parallel) {
+        in_parallel_loop = false;
+        *outputC << "}" << endl;
+    }
+    *outputC << "}" << endl;
+    done(statement, head.start);
+}
+
+bool c_emitter::opened(open_statement& statement) {
+    open.push_back(statement);
+    return true;
+}
+
+// a top-level statement is a --trace span of its own
+void c_emitter::done(const st* statement, uint64_t start) {
+    *outputC << endl;
+    if (open.empty() && trace_enabled)
+        trace_record("compile statement", start, statement->line);
+}
+
+const char* checked_helper(token op) {
+    switch (op) {
+        case t_add: return "calc_checked_add";
+        case t_sub: return "calc_checked_sub";
+        case t_mul: return "calc_checked_mul";
+        default: return NULL;
+    }
+}
+
+// one operator applied to operands already in C
+string operation_text(bin_op* node, const string& l, const string& r) {
+    const char* helper = checked_helper(node->type);
+    if (options.checked && helper && may_overflow(node))
+        return " " + string(helper) + "(" + l + ", " + r + ")";
+
+    // the result needs more than int, widen before the operation rather than after; the source's <> is C's !=
+    return string(" (") + (fits_int(node) ? "" : "(int64_t)") + l + (node->type == t_noteq ? "!=" : node->name) + r + ")";
+}
+
+// prefix tree traversal, variables are renamed through `names` when given
+string relation_text(bin_op* root, const map<string, string>* names) {
+    if (root->l_child != NULL && root->r_child != NULL)
+        return operation_text(root, relation_text(root->l_child, names), relation_text(root->r_child, names));
+
+    if (root->type == t_id && names) {
+        map<string, string>::const_iterator found = names->find(root->name);
+        if (found != names->end())
+            return found->second;
+    }
+    return root->name;
+}
+
+void compile_relation(bin_op* root) {
+    *outputC << relation_text(root, NULL);
+}
+
+/*
+ * C from the SSA form
+ *
+ * every value is a local declared where it is defined, phi nodes become a
+ * variable declared before their if or loop and assigned on each incoming edge
+ */
+const char* value_type(const ssa_value& v) {
+    if (!v.var.empty())
+        return variable_type(v.var);
+    return fits_int(v.node) ? "int" : "int64_t";
+}
+
+void compile_ssa_phis(const ssa_program& program, const vector<ssa_phi>& phis, bool declare, int arg) {
+    for (size_t i = 0; i < phis.size(); i++) {
+        const ssa_value& def = program.values[phis[i].def];
+        if (!declare && phis[i].args[arg] == phis[i].def)
+            continue;
+        if (declare)
+            *outputC << value_type(def) << " ";
+        *outputC << def.name << " = " << program.values[phis[i].args[arg]].name << ";" << endl;
+    }
+}
+
+void compile_ssa_block(const ssa_program& program, const vector<ssa_inst>& body) {
+    for (size_t i = 0; i < body.size(); i++) {
+        const ssa_inst& inst = body[i];
+        const ssa_value* def = inst.def >= 0 ? &program.values[inst.def] : NULL;
+        const ssa_value* arg = inst.args[0] >= 0 ? &program.values[inst.args[0]] : NULL;
+        map<string, string> header;
+
+        switch (inst.kind) {
+            case s_binary:
+                *outputC << value_type(*def) << " " << def->name << " ="
+                        << operation_text(inst.node, arg->name, program.values[inst.args[1]].name) << ";" << endl;
+                break;
+            case s_copy:
+                *outputC << value_type(*def) << " " << def->name << " = " << arg->name << ";" << endl;
+                break;
+            case s_read:
+                *outputC << value_type(*def) << " " << def->name << " = " << arg->name << ";" << endl;
+                compile_read(def->name, value_type(*def));
+                break;
+            case s_write:
+                compile_write(inst.node, " " + arg->name);
+                break;
+            case s_if:
+                compile_ssa_phis(program, inst.phis, true, 0);
+                *outputC << "if (" << arg->name << ") {" << endl;
+                compile_ssa_block(program, inst.body);
+                compile_ssa_phis(program, inst.phis, false, 1);
+                *outputC << "}" << endl;
+                break;
+            case s_loop:
+                compile_ssa_phis(program, inst.phis, true, 0);
+                compile_ssa_phis(program, inst.exits, true, 0);
+                if (inst.hoisted) {
+                    for (map<string, int>::const_iterator it = inst.header.begin(); it != inst.header.end(); it++)
+                        header[it->first] = program.values[it->second].name;
+                    *outputC << "while (" << relation_text(inst.node, &header) << ") {" << endl;
+                } else {
+                    *outputC << "for (;;) {" << endl;
+                }
+                compile_ssa_block(program, inst.body);
+                compile_ssa_phis(program, inst.phis, false, 1);
+                *outputC << "}" << endl;
+                break;
+            case s_check:
+                *outputC << "if (!" << arg->name << ") {" << endl;
+                for (size_t j = 0; j < inst.copies.size(); j++)
+                    *outputC << program.values[inst.copies[j].first].name << " = "
+                            << program.values[inst.copies[j].second].name << ";" << endl;
+                *outputC << "break;" << endl << "}" << endl;
+                break;
+        }
+    }
+}
+
+void compile_ssa(st_list* root) {
+    ssa_program program;
+    build_ssa(root, program);
 
-    if (root->l_child != NULL && root->r_child != NULL) {
-        outputC << ")";
+    for (size_t i = 0; i < program.initial.size(); i++) {
+        const ssa_value& v = program.values[program.initial[i]];
+        *outputC << value_type(v) << " " << v.name << " = 0;" << endl;
     }
+    compile_ssa_block(program, program.body);
 }
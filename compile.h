@@ -5,8 +5,37 @@
 #ifndef PL_A2_COMPILE_H
 #define PL_A2_COMPILE_H
 
+#include <string>
 #include "ast.h"
 
-void compileToC(st_list* root);
+struct compile_options {
+    bool checked;       // trap on overflow wherever the range analysis cannot rule it out
+    bool ssa;           // emit from the SSA form instead of straight from the AST
+    bool loop_hints;    // ivdep/unroll pragmas on counted loops
+    bool stdio;         // scanf/printf per number instead of the buffered runtime
+    int jobs;           // threads printing the AST and emitting top-level statements
+    bool profile;       // count runs of every statement and iterations of every loop, report at exit
+    std::string profile_use;    // the report of such a run, to lay out branches and loops by, see feedback.h
+    bool openmp;        // #pragma omp parallel for on counted loops with independent iterations, see depend.h
+    bool closed_forms;  // counted loops whose results have a closed form compute it instead, see scev.h
+    std::string function;   // not main but this static function, for a batch (batch.h) that has the runtime in front
+    int lanes;          // input sets run at once in the lanes of vectors, 0: one run of the program, see lanes.h
+
+    compile_options() : checked(false), ssa(false), loop_hints(false), stdio(false), jobs(1), profile(false),
+                        openmp(false), closed_forms(true), lanes(0) {}
+};
+
+// --jobs=N above this is refused, more threads than that only split the work finer
+const int jobs_max = 64;
+
+struct range_info;
+
+// writes the C program for root to out; the range analysis is done unless given; with ast the
+// statements are printed there too (print_stmts), in the same walk over the tree (visit.h)
+void compileToC(st_list* root, const compile_options& options, std::ostream& out,
+                const range_info* analyzed = NULL, std::ostream* ast = NULL);
+
+// what the functions of a batch share: includes, runtime and helpers for these options, --profile aside
+void compile_batch_prelude(const compile_options& options, std::ostream& out);
 
 #endif //PL_A2_COMPILE_H
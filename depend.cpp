@@ -0,0 +1,158 @@
+#include "depend.h"
+#include <cstring>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// the variable appears in node
+static bool mentions(bin_op* node, const char* var) {
+    if (node == NULL)
+        return false;
+    if (node->type == t_id && strcmp(node->name, var) == 0)
+        return true;
+    return mentions(node->l_child, var) || mentions(node->r_child, var);
+}
+
+static void collect_mentioned(bin_op* node, set<string>& vars) {
+    if (node == NULL)
+        return;
+    if (node->type == t_id)
+        vars.insert(node->name);
+    collect_mentioned(node->l_child, vars);
+    collect_mentioned(node->r_child, vars);
+}
+
+// every variable a statement reads or assigns, down to the leaves
+static void collect_touched(st* s, set<string>& vars) {
+    if (s->type == t_id || s->type == t_read)
+        vars.insert(s->id);
+    collect_mentioned(s->rel, vars);
+    for (st_list* sl = s->sl; sl != NULL; sl = sl->r_child)
+        if (sl->l_child)
+            collect_touched(sl->l_child, vars);
+}
+
+// nothing that must stay in order: no read or write, no check but in nested loops
+static bool independent_control(st_list* sl, st_list* last, bool& nested) {
+    for (; sl != NULL && sl != last; sl = sl->r_child) {
+        st* s = sl->l_child;
+        if (!s)
+            continue;
+        if (s->type == t_read || s->type == t_write || s->type == t_check)
+            return false;
+        if (s->type == t_do) {
+            nested = true;
+            // the checks of this loop are its own
+            for (st_list* inner = s->sl; inner != NULL; inner = inner->r_child)
+                if (inner->l_child && inner->l_child->type != t_check
+                    && !independent_control(inner, inner->r_child, nested))
+                    return false;
+        } else if (s->type == t_if && !independent_control(s->sl, NULL, nested)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// variables assigned at the top level before anything in the body touched them
+static void find_privates(st_list* sl, st_list* last, set<string>& touched, set<string>& privates) {
+    for (; sl != NULL && sl != last; sl = sl->r_child) {
+        st* s = sl->l_child;
+        if (!s)
+            continue;
+        if (s->type == t_id && touched.find(s->id) == touched.end() && !mentions(s->rel, s->id))
+            privates.insert(s->id);
+        collect_touched(s, touched);
+    }
+}
+
+// the operands of a sum, with the sign each is added with
+static void additive_terms(bin_op* node, int sign, vector<pair<bin_op*, int> >& terms) {
+    if (node->type == t_add || node->type == t_sub) {
+        additive_terms(node->l_child, sign, terms);
+        additive_terms(node->r_child, node->type == t_add ? sign : -sign, terms);
+    } else {
+        terms.push_back(make_pair(node, sign));
+    }
+}
+
+/*
+ * every mention of var from sl up to last is in an update var := var + ...,
+ * side is the sign of what the updates add so far, 0 while nothing is known
+ */
+static bool only_summed(st_list* sl, st_list* last, const char* var, const range_info& ranges, int& side) {
+    for (; sl != NULL && sl != last; sl = sl->r_child) {
+        st* s = sl->l_child;
+        if (!s)
+            continue;
+        if (s->type != t_id || strcmp(s->id, var) != 0) {
+            if (mentions(s->rel, var) || !only_summed(s->sl, NULL, var, ranges, side))
+                return false;
+            continue;
+        }
+
+        vector<pair<bin_op*, int> > terms;
+        additive_terms(s->rel, 1, terms);
+        int self = 0;
+        for (size_t i = 0; i < terms.size(); i++) {
+            bin_op* term = terms[i].first;
+            if (term->type == t_id && strcmp(term->name, var) == 0 && terms[i].second > 0) {
+                self++;
+                continue;
+            }
+            if (mentions(term, var))
+                return false;
+            map<const bin_op*, range>::const_iterator found = ranges.nodes.find(term);
+            if (found == ranges.nodes.end())
+                return false;
+            range r = found->second;
+            int sign = r.lo >= 0 ? (r.hi > 0 ? 1 : 0) : (r.hi <= 0 ? -1 : 2);
+            if (sign == 2)
+                return false;
+            sign *= terms[i].second;
+            if (sign != 0 && side != 0 && sign != side)
+                return false;
+            if (sign != 0)
+                side = sign;
+        }
+        if (self != 1)
+            return false;
+    }
+    return true;
+}
+
+bool analyze_dependences(st* loop, const range_info& ranges, loop_dependences& result) {
+    counted_loop& shape = result.shape;
+    if (!recognize_counted_shape(loop, shape))
+        return false;
+    result.nested = false;
+    result.privates.clear();
+    result.reductions.clear();
+    if (!independent_control(shape.first, shape.last, result.nested))
+        return false;
+
+    set<string> touched, privates;
+    collect_mentioned(shape.check->rel, touched);
+    find_privates(shape.first, shape.last, touched, privates);
+
+    set<string> assigned;
+    collect_assigned(shape.first, assigned);
+    assigned.erase(shape.var);      // the step, recognize_counted_shape made sure
+    for (set<string>::iterator it = assigned.begin(); it != assigned.end(); it++) {
+        if (privates.find(*it) != privates.end()) {
+            result.privates.insert(*it);
+            continue;
+        }
+        int side = 0;
+        if (!only_summed(shape.first, shape.last, it->c_str(), ranges, side))
+            return false;
+        map<string, range>::const_iterator found = ranges.variables.find(*it);
+        if (found == ranges.variables.end())
+            return false;
+        if ((side > 0 && found->second.lo < 0) || (side < 0 && found->second.hi > 0))
+            return false;
+        result.reductions.insert(*it);
+    }
+    return true;
+}
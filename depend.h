@@ -0,0 +1,37 @@
+#ifndef __DEPEND_H
+#define __DEPEND_H
+
+#include <set>
+#include <string>
+#include "ast.h"
+#include "loop.h"
+#include "range.h"
+
+/*
+ * dependence analysis of a do loop in counted shape (loop.h), nested loops
+ * allowed in its body, for parse --openmp
+ *
+ * The iterations are independent, they may run in any order on any thread,
+ * when every variable assigned in the body is one of
+ * - the induction variable, which only the step assigns
+ * - private: assigned at the top level of the body before anything in the
+ *   iteration reads it, so each iteration has its own; after the loop it
+ *   holds what the last iteration left in it
+ * - a reduction: a sum, only ever assigned s := s + e1 - e2 ..., with s in
+ *   none of the terms and read nowhere else in the loop. The terms must all
+ *   add on one side of zero, and s start on that side, so that the partial
+ *   sums of the threads lie between 0 and the value s ends with
+ * Any other variable is carried from one iteration to the next. A loop that
+ * reads or writes keeps its order, as does one leaving by a check of its own
+ * other than the condition (checks of nested loops end those loops only).
+ */
+struct loop_dependences {
+    counted_loop shape;
+    std::set<std::string> privates;
+    std::set<std::string> reductions;
+    bool nested;            // loops in the body
+};
+
+bool analyze_dependences(st* loop, const range_info& ranges, loop_dependences& result);
+
+#endif
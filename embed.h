@@ -0,0 +1,466 @@
+#ifndef __EMBED_H
+#define __EMBED_H
+
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+/*
+ * calculator programs embedded in C++, header only (C++17)
+ *
+ *   static constexpr auto sum = calc::embed(R"(
+ *       read n
+ *       ...
+ *   )");
+ *   calc::run<sum>(read, write);
+ *
+ * embed() scans and parses the program like scan.cpp and parse.cpp and
+ * applies the do/check rules of semantic.h while the compiler evaluates the
+ * constexpr initializer: a syntax error or a broken rule is a compile error,
+ * a call to embedded::fail() with the reason. There is no error recovery,
+ * the first error is the one reported.
+ *
+ * run<> is instantiated per statement and expression node, the operators
+ * and variable slots are constants in it, so the compiler turns the program
+ * into straight code and nothing is parsed at run time. read(long long&)
+ * returns false at the end of the input (the variable keeps its value),
+ * write(long long) gets every value the program writes; run<> returns the
+ * variables, by slot (program::slot). It is constexpr too: a program on
+ * fixed input can be checked by static_assert.
+ *
+ * Values are 64 bit and arithmetic wraps, unset variables are 0, division
+ * by zero throws std::domain_error. The C backend keeps variables in the
+ * narrowest type the range analysis allows, so both agree unless the C
+ * program would overflow, or read a number too big for an int variable.
+ */
+namespace calc {
+
+namespace embedded {
+
+enum token {
+    t_eof, t_id, t_literal, t_gets, t_lparen, t_rparen,
+    t_read, t_write, t_if, t_fi, t_do, t_od, t_check,
+    t_add, t_sub, t_mul, t_div, t_eq, t_noteq, t_lt, t_gt, t_lte, t_gte
+};
+
+// the operators in the order of their tokens
+enum kind {
+    n_assign, n_read, n_write, n_if, n_do, n_check,
+    n_var, n_literal,
+    n_add, n_sub, n_mul, n_div, n_eq, n_noteq, n_lt, n_gt, n_lte, n_gte
+};
+
+struct node {
+    kind what = n_literal;
+    int slot = 0;           // assign, read and var: the variable
+    int l = -1;             // assign, write, if, check: the relation; operators: the operands
+    int r = -1;
+    int body = 0;           // if, do: their statements, order[body] on ...
+    int length = 0;         // ... for this many
+    int next = -1;          // statements: the one after it in its list
+    long long value = 0;    // literal
+};
+
+/*
+ * a program of a source of N chars: every token makes one node at most,
+ * every variable is named by one. The statements of every list are laid
+ * out in a row in order[], which is what run<> goes through
+ */
+template <size_t N>
+struct program {
+    node nodes[N] = {};
+    int count = 0;
+    int order[N] = {};
+    int top = 0;                // the top level list, order[top] on ...
+    int length = 0;             // ... for this many
+    char text[N] = {};
+    int name_start[N] = {};     // variables by slot, spans of text
+    int name_length[N] = {};
+    int variables = 0;
+
+    // the slot of a variable, -1 if the program has none by that name
+    constexpr int slot(std::string_view name) const {
+        for (int i = 0; i < variables; i++)
+            if (std::string_view(text + name_start[i], name_length[i]) == name)
+                return i;
+        return -1;
+    }
+};
+
+// not constexpr: reaching it while the compiler evaluates embed() is the compile error
+inline void fail(const char* reason) {
+    throw std::invalid_argument(reason);
+}
+
+[[noreturn]] inline void division_by_zero() {
+    throw std::domain_error("division by zero");
+}
+
+enum precedence {
+    p_none, p_relation, p_add, p_mul
+};
+
+constexpr int precedence_of(token t) {
+    switch (t) {
+        case t_eq: case t_noteq: case t_lt: case t_gt: case t_lte: case t_gte:
+            return p_relation;
+        case t_add: case t_sub:
+            return p_add;
+        case t_mul: case t_div:
+            return p_mul;
+        default:
+            return p_none;
+    }
+}
+
+constexpr bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+constexpr bool is_alpha(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+constexpr bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+template <size_t N>
+struct parser {
+    program<N> p;
+    size_t size = 0;
+    size_t pos = 0;
+    token tok = t_eof;
+    size_t start = 0;           // the image of tok in p.text
+    size_t length = 0;
+    bool has_check[N] = {};     // by do node
+
+    constexpr char peek() const {
+        return pos < size ? p.text[pos] : '\0';
+    }
+
+    // scan.cpp's scan_text, without the messages
+    constexpr void scan() {
+        while (pos < size && is_space(p.text[pos]))
+            pos++;
+        start = pos;
+        if (pos == size) {
+            tok = t_eof;
+            length = 0;
+            return;
+        }
+        char c = p.text[pos++];
+        if (is_alpha(c)) {
+            while (is_alpha(peek()) || is_digit(peek()) || peek() == '_')
+                pos++;
+            std::string_view word(p.text + start, pos - start);
+            tok = word == "if" ? t_if : word == "fi" ? t_fi : word == "do" ? t_do : word == "od" ? t_od
+                : word == "read" ? t_read : word == "write" ? t_write : word == "check" ? t_check : t_id;
+        } else if (is_digit(c)) {
+            while (is_digit(peek()))
+                pos++;
+            tok = t_literal;
+        } else {
+            switch (c) {
+                case ':':
+                    if (peek() != '=')
+                        fail("expect := , get :");
+                    pos++;
+                    tok = t_gets;
+                    break;
+                case '+': tok = t_add; break;
+                case '-': tok = t_sub; break;
+                case '*': tok = t_mul; break;
+                case '/': tok = t_div; break;
+                case '(': tok = t_lparen; break;
+                case ')': tok = t_rparen; break;
+                case '=':
+                    if (peek() != '=')
+                        fail("expect == , get =");
+                    pos++;
+                    tok = t_eq;
+                    break;
+                // like scan.cpp, a lone < or > is followed by a blank
+                case '<':
+                    if (peek() == '>')
+                        tok = t_noteq;
+                    else if (peek() == '=')
+                        tok = t_lte;
+                    else if (peek() == ' ')
+                        tok = t_lt;
+                    else
+                        fail("expect <= or <> or < and a blank");
+                    pos++;
+                    break;
+                case '>':
+                    if (peek() == '=')
+                        tok = t_gte;
+                    else if (peek() == ' ')
+                        tok = t_gt;
+                    else
+                        fail("expect >= or > and a blank");
+                    pos++;
+                    break;
+                default:
+                    fail("not a character of the language");
+            }
+        }
+        length = pos - start;
+    }
+
+    constexpr void match(token t, const char* reason) {
+        if (tok != t)
+            fail(reason);
+        scan();
+    }
+
+    constexpr int add_node(kind what) {
+        p.nodes[p.count].what = what;
+        return p.count++;
+    }
+
+    // the slot of the id just scanned, a new one the first time
+    constexpr int variable() {
+        std::string_view name(p.text + start, length);
+        for (int i = 0; i < p.variables; i++)
+            if (std::string_view(p.text + p.name_start[i], p.name_length[i]) == name)
+                return i;
+        p.name_start[p.variables] = start;
+        p.name_length[p.variables] = length;
+        return p.variables++;
+    }
+
+    constexpr int factor() {
+        int n = -1;
+        switch (tok) {
+            case t_id:
+                n = add_node(n_var);
+                p.nodes[n].slot = variable();
+                scan();
+                break;
+            case t_literal:
+                n = add_node(n_literal);
+                for (size_t i = start; i < start + length; i++) {
+                    long long digit = p.text[i] - '0';
+                    if (p.nodes[n].value > (0x7fffffffffffffffLL - digit) / 10)
+                        fail("literal does not fit 64 bits");
+                    p.nodes[n].value = p.nodes[n].value * 10 + digit;
+                }
+                scan();
+                break;
+            case t_lparen:
+                scan();
+                n = climb(p_relation);
+                match(t_rparen, "expect )");
+                break;
+            default:
+                fail("expect an id, a literal or (");
+        }
+        return n;
+    }
+
+    // parse.cpp's precedence climbing: left associative, relations do not chain
+    constexpr int climb(int min_prec) {
+        int lhs = factor();
+        for (;;) {
+            int prec = precedence_of(tok);
+            if (prec == p_none || prec < min_prec)
+                break;
+            token op = tok;
+            scan();
+            int rhs = climb(prec + 1);
+            int n = add_node(kind(n_add + (op - t_add)));
+            p.nodes[n].l = lhs;
+            p.nodes[n].r = rhs;
+            lhs = n;
+            if (prec == p_relation)
+                break;
+        }
+        return lhs;
+    }
+
+    /*
+     * the statements up to fi, od or the end, linked by next; loop is the
+     * innermost open frame when that is a do, -1 when it is an if or there
+     * is none (semantic.h)
+     */
+    constexpr int stmt_list(int loop) {
+        int first = -1, last = -1;
+        while (tok != t_eof && tok != t_fi && tok != t_od) {
+            int s = stmt(loop);
+            if (last < 0)
+                first = s;
+            else
+                p.nodes[last].next = s;
+            last = s;
+        }
+        return first;
+    }
+
+    constexpr int stmt(int loop) {
+        int s = -1;
+        switch (tok) {
+            case t_id:
+                s = add_node(n_assign);
+                p.nodes[s].slot = variable();
+                scan();
+                match(t_gets, "expect :=");
+                p.nodes[s].l = climb(p_relation);
+                break;
+            case t_read:
+                s = add_node(n_read);
+                scan();
+                if (tok != t_id)
+                    fail("expect an id after read");
+                p.nodes[s].slot = variable();
+                scan();
+                break;
+            case t_write:
+                s = add_node(n_write);
+                scan();
+                p.nodes[s].l = climb(p_relation);
+                break;
+            case t_if:
+                s = add_node(n_if);
+                scan();
+                p.nodes[s].l = climb(p_relation);
+                p.nodes[s].body = stmt_list(-1);
+                match(t_fi, "expect fi");
+                break;
+            case t_do:
+                s = add_node(n_do);
+                scan();
+                p.nodes[s].body = stmt_list(s);
+                match(t_od, "expect od");
+                if (!has_check[s])
+                    fail("do statement without a check of its own");
+                break;
+            case t_check:
+                if (loop < 0)
+                    fail("check statement not inside a do, or inside an if in it");
+                has_check[loop] = true;
+                s = add_node(n_check);
+                scan();
+                p.nodes[s].l = climb(p_relation);
+                break;
+            default:
+                fail("expect a statement");
+        }
+        return s;
+    }
+
+    // lists in a row in order[], from *at on: the list first, then the lists in it
+    constexpr void lay_out(int first, int& body, int& length, int& at) {
+        body = at;
+        length = 0;
+        for (int s = first; s >= 0; s = p.nodes[s].next, length++)
+            p.order[at++] = s;
+        for (int i = body; i < body + length; i++) {
+            node& n = p.nodes[p.order[i]];
+            if (n.what == n_if || n.what == n_do)
+                lay_out(n.body, n.body, n.length, at);
+        }
+    }
+};
+
+template <const auto& P, int E>
+constexpr long long value(const long long* v) {
+    constexpr node n = P.nodes[E];
+    if constexpr (n.what == n_var) {
+        return v[n.slot];
+    } else if constexpr (n.what == n_literal) {
+        return n.value;
+    } else {
+        long long a = value<P, n.l>(v);
+        long long b = value<P, n.r>(v);
+        if constexpr (n.what == n_add)
+            return (long long) ((unsigned long long) a + (unsigned long long) b);
+        else if constexpr (n.what == n_sub)
+            return (long long) ((unsigned long long) a - (unsigned long long) b);
+        else if constexpr (n.what == n_mul)
+            return (long long) ((unsigned long long) a * (unsigned long long) b);
+        else if constexpr (n.what == n_div) {
+            if (b == 0)
+                division_by_zero();
+            return b == -1 ? (long long) (0 - (unsigned long long) a) : a / b;
+        }
+        else if constexpr (n.what == n_eq)
+            return a == b;
+        else if constexpr (n.what == n_noteq)
+            return a != b;
+        else if constexpr (n.what == n_lt)
+            return a < b;
+        else if constexpr (n.what == n_gt)
+            return a > b;
+        else if constexpr (n.what == n_lte)
+            return a <= b;
+        else
+            return a >= b;
+    }
+}
+
+template <const auto& P, int S, class In, class Out>
+constexpr bool exec_stmt(long long* v, In& in, Out& out);
+
+// false if a check left the loop; a check is never in an if, so only a do sees false
+template <const auto& P, int Body, class In, class Out, size_t... I>
+constexpr bool exec_list(long long* v, In& in, Out& out, std::index_sequence<I...>) {
+    return (exec_stmt<P, P.order[Body + I]>(v, in, out) && ...);
+}
+
+template <const auto& P, int S, class In, class Out>
+constexpr bool exec_stmt(long long* v, In& in, Out& out) {
+    constexpr node n = P.nodes[S];
+    if constexpr (n.what == n_assign) {
+        v[n.slot] = value<P, n.l>(v);
+    } else if constexpr (n.what == n_read) {
+        long long x = 0;
+        if (in(x))
+            v[n.slot] = x;
+    } else if constexpr (n.what == n_write) {
+        out(value<P, n.l>(v));
+    } else if constexpr (n.what == n_if) {
+        if (value<P, n.l>(v))
+            exec_list<P, n.body>(v, in, out, std::make_index_sequence<n.length>());
+    } else if constexpr (n.what == n_do) {
+        while (exec_list<P, n.body>(v, in, out, std::make_index_sequence<n.length>()))
+            ;
+    } else {
+        return value<P, n.l>(v) != 0;
+    }
+    return true;
+}
+
+}
+
+template <size_t N>
+constexpr embedded::program<N> embed(const char (&source)[N]) {
+    embedded::parser<N> parse;
+    parse.size = N - 1;
+    for (size_t i = 0; i < N; i++)
+        parse.p.text[i] = source[i];
+    parse.scan();
+    int first = parse.stmt_list(-1);
+    if (parse.tok != embedded::t_eof)
+        embedded::fail("expect a statement");
+    int at = 0;
+    parse.lay_out(first, parse.p.top, parse.p.length, at);
+    return parse.p;
+}
+
+// the variables of a program, by slot; a program without any still has one
+template <const auto& P>
+using variables = std::array<long long, (P.variables > 0 ? P.variables : 1)>;
+
+template <const auto& P, class In, class Out>
+constexpr variables<P> run(In&& read, Out&& write) {
+    variables<P> v = {};
+    embedded::exec_list<P, P.top>(v.data(), read, write, std::make_index_sequence<P.length>());
+    return v;
+}
+
+}
+
+#endif
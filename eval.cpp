@@ -0,0 +1,757 @@
+#include "eval.h"
+#include "range.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct EvalException : public exception {
+    const char* message;
+    EvalException(const char* message) : message(message) {}
+    const char * what () const throw () {
+        return message;
+    }
+};
+
+/*
+ * the I/O runtime of the generated C (io_runtime in compile.cpp), on FILE*
+ */
+struct eval_io {
+    FILE* in;
+    FILE* out;
+    char in_buffer[1 << 16];
+    size_t in_len, in_pos;
+    char out_buffer[1 << 16];
+    size_t out_len;
+};
+
+static eval_io* io_open(FILE* in, FILE* out) {
+    eval_io* io = new eval_io;
+    io->in = in;
+    io->out = out;
+    io->in_len = io->in_pos = io->out_len = 0;
+    return io;
+}
+
+static void io_flush(eval_io& io) {
+    fwrite(io.out_buffer, 1, io.out_len, io.out);
+    io.out_len = 0;
+    fflush(io.out);
+}
+
+static inline int io_getc(eval_io& io) {
+    if (io.in_pos == io.in_len) {
+        io.in_len = fread(io.in_buffer, 1, sizeof io.in_buffer, io.in);
+        io.in_pos = 0;
+        if (io.in_len == 0)
+            return EOF;
+    }
+    return (unsigned char) io.in_buffer[io.in_pos++];
+}
+
+static bool io_read(eval_io& io, long long& v) {
+    int c = io_getc(io);
+    while (c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f')
+        c = io_getc(io);
+    bool negative = c == '-';
+    if (c == '-' || c == '+')
+        c = io_getc(io);
+    if (c < '0' || c > '9')
+        return false;
+    unsigned long long n = 0;
+    do {
+        n = n * 10 + (c - '0');
+        c = io_getc(io);
+    } while (c >= '0' && c <= '9');
+    if (c != EOF)
+        io.in_pos--;
+    v = negative ? (long long) -n : (long long) n;
+    return true;
+}
+
+static void io_write(eval_io& io, long long v) {
+    char digits[24];
+    int i = 0;
+    unsigned long long n = v < 0 ? -(unsigned long long) v : (unsigned long long) v;
+    if (io.out_len + sizeof digits > sizeof io.out_buffer)
+        io_flush(io);
+    if (v < 0)
+        io.out_buffer[io.out_len++] = '-';
+    do {
+        digits[i++] = '0' + n % 10;
+        n /= 10;
+    } while (n);
+    while (i)
+        io.out_buffer[io.out_len++] = digits[--i];
+    io.out_buffer[io.out_len++] = '\n';
+}
+
+/*
+ * operators, wrapping like the int64_t arithmetic of the generated C;
+ * the checked ones trap where calc_checked_* would
+ */
+struct op_add { static long long apply(long long a, long long b) { return (long long) ((unsigned long long) a + b); } };
+struct op_sub { static long long apply(long long a, long long b) { return (long long) ((unsigned long long) a - b); } };
+struct op_mul { static long long apply(long long a, long long b) { return (long long) ((unsigned long long) a * b); } };
+struct op_div {
+    static long long apply(long long a, long long b) {
+        if (b == 0)
+            throw EvalException("division by zero");
+        if (b == -1)
+            return (long long) -(unsigned long long) a;
+        return a / b;
+    }
+};
+struct op_eq { static long long apply(long long a, long long b) { return a == b; } };
+struct op_ne { static long long apply(long long a, long long b) { return a != b; } };
+struct op_lt { static long long apply(long long a, long long b) { return a < b; } };
+struct op_gt { static long long apply(long long a, long long b) { return a > b; } };
+struct op_le { static long long apply(long long a, long long b) { return a <= b; } };
+struct op_ge { static long long apply(long long a, long long b) { return a >= b; } };
+
+struct op_checked_add {
+    static long long apply(long long a, long long b) {
+        long long r;
+        if (__builtin_add_overflow(a, b, &r))
+            throw EvalException("integer overflow");
+        return r;
+    }
+};
+struct op_checked_sub {
+    static long long apply(long long a, long long b) {
+        long long r;
+        if (__builtin_sub_overflow(a, b, &r))
+            throw EvalException("integer overflow");
+        return r;
+    }
+};
+struct op_checked_mul {
+    static long long apply(long long a, long long b) {
+        long long r;
+        if (__builtin_mul_overflow(a, b, &r))
+            throw EvalException("integer overflow");
+        return r;
+    }
+};
+
+/*
+ * closures: fn is picked when the node is converted, for its operator and
+ * for where its operands come from, and does only that
+ */
+struct eval_expr;
+typedef long long (*eval_fn)(const eval_expr* e, long long* vars);
+
+struct eval_expr {
+    eval_fn fn;
+    int a, b;               // slots of variable operands
+    long long k;            // the literal operand
+    const eval_expr* l;     // subexpression operands
+    const eval_expr* r;
+};
+
+static long long e_var(const eval_expr* e, long long* vars) { return vars[e->a]; }
+static long long e_lit(const eval_expr* e, long long* vars) { return e->k; }
+
+template <class Op> long long e_vv(const eval_expr* e, long long* v) { return Op::apply(v[e->a], v[e->b]); }
+template <class Op> long long e_vk(const eval_expr* e, long long* v) { return Op::apply(v[e->a], e->k); }
+template <class Op> long long e_kv(const eval_expr* e, long long* v) { return Op::apply(e->k, v[e->b]); }
+template <class Op> long long e_ve(const eval_expr* e, long long* v) { return Op::apply(v[e->a], e->r->fn(e->r, v)); }
+template <class Op> long long e_ev(const eval_expr* e, long long* v) { return Op::apply(e->l->fn(e->l, v), v[e->b]); }
+template <class Op> long long e_ek(const eval_expr* e, long long* v) { return Op::apply(e->l->fn(e->l, v), e->k); }
+template <class Op> long long e_ke(const eval_expr* e, long long* v) { return Op::apply(e->k, e->r->fn(e->r, v)); }
+template <class Op> long long e_ee(const eval_expr* e, long long* v) {
+    return Op::apply(e->l->fn(e->l, v), e->r->fn(e->r, v));
+}
+
+enum operand { o_var, o_lit, o_expr };
+
+template <class Op> eval_fn pick(operand l, operand r) {
+    if (l == o_var)
+        return r == o_var ? e_vv<Op> : r == o_lit ? e_vk<Op> : e_ve<Op>;
+    if (l == o_lit)
+        return r == o_var ? e_kv<Op> : e_ke<Op>;
+    return r == o_var ? e_ev<Op> : r == o_lit ? e_ek<Op> : e_ee<Op>;
+}
+
+static eval_fn pick_operator(token op, bool checked, operand l, operand r) {
+    switch (op) {
+        case t_add: return checked ? pick<op_checked_add>(l, r) : pick<op_add>(l, r);
+        case t_sub: return checked ? pick<op_checked_sub>(l, r) : pick<op_sub>(l, r);
+        case t_mul: return checked ? pick<op_checked_mul>(l, r) : pick<op_mul>(l, r);
+        case t_div: return pick<op_div>(l, r);
+        case t_eq: return pick<op_eq>(l, r);
+        case t_noteq: return pick<op_ne>(l, r);
+        case t_lt: return pick<op_lt>(l, r);
+        case t_gt: return pick<op_gt>(l, r);
+        case t_lte: return pick<op_le>(l, r);
+        case t_gte: return pick<op_ge>(l, r);
+        default: return NULL;
+    }
+}
+
+struct eval_state {
+    long long* vars;
+    eval_io* io;
+
+    // pair profile: pairs[first * kinds + second], last is the kind run last
+    long long* pairs;
+    int kinds;
+    int last;
+};
+
+// true when a check left the innermost do
+struct eval_stmt;
+typedef bool (*exec_fn)(const eval_stmt* s, eval_state& state);
+
+struct eval_stmt {
+    exec_fn fn;
+    int slot;
+    bool narrow;                    // read into an int variable
+    const eval_expr* rel;
+    const eval_stmt* const* body;   // if and do
+    size_t count;
+
+    int a, b;                       // operands of a fused statement, slots
+    long long k;                    // and literal
+
+    int kind;                       // for the pair profile, see eval_code
+    exec_fn real;                   // what fn was before the profile wrapped it
+};
+
+static bool exec_list(const eval_stmt* const* body, size_t count, eval_state& state) {
+    for (size_t i = 0; i < count; i++)
+        if (body[i]->fn(body[i], state))
+            return true;
+    return false;
+}
+
+static bool x_assign(const eval_stmt* s, eval_state& state) {
+    state.vars[s->slot] = s->rel->fn(s->rel, state.vars);
+    return false;
+}
+
+static bool x_read(const eval_stmt* s, eval_state& state) {
+    long long n;
+    if (io_read(*state.io, n))
+        state.vars[s->slot] = s->narrow ? (long long) (int) n : n;
+    return false;
+}
+
+static bool x_write(const eval_stmt* s, eval_state& state) {
+    io_write(*state.io, s->rel->fn(s->rel, state.vars));
+    return false;
+}
+
+static bool x_if(const eval_stmt* s, eval_state& state) {
+    if (s->rel->fn(s->rel, state.vars))
+        return exec_list(s->body, s->count, state);
+    return false;
+}
+
+static bool x_do(const eval_stmt* s, eval_state& state) {
+    while (!exec_list(s->body, s->count, state))
+        ;
+    return false;
+}
+
+static bool x_check(const eval_stmt* s, eval_state& state) {
+    return !s->rel->fn(s->rel, state.vars);
+}
+
+static bool x_none(const eval_stmt* s, eval_state& state) {
+    return false;
+}
+
+/*
+ * superinstructions: statements whose relation is one operator on variables
+ * and literals do the operator themselves, one call instead of two or three;
+ * x := x + k is an increment
+ */
+static bool x_inc(const eval_stmt* s, eval_state& state) {
+    state.vars[s->slot] = op_add::apply(state.vars[s->slot], s->k);
+    return false;
+}
+
+static bool x_inc_checked(const eval_stmt* s, eval_state& state) {
+    state.vars[s->slot] = op_checked_add::apply(state.vars[s->slot], s->k);
+    return false;
+}
+
+template <class Op> bool x_assign_vv(const eval_stmt* s, eval_state& state) {
+    state.vars[s->slot] = Op::apply(state.vars[s->a], state.vars[s->b]);
+    return false;
+}
+template <class Op> bool x_assign_vk(const eval_stmt* s, eval_state& state) {
+    state.vars[s->slot] = Op::apply(state.vars[s->a], s->k);
+    return false;
+}
+template <class Op> bool x_assign_kv(const eval_stmt* s, eval_state& state) {
+    state.vars[s->slot] = Op::apply(s->k, state.vars[s->b]);
+    return false;
+}
+
+template <class Op> bool x_check_vv(const eval_stmt* s, eval_state& state) {
+    return !Op::apply(state.vars[s->a], state.vars[s->b]);
+}
+template <class Op> bool x_check_vk(const eval_stmt* s, eval_state& state) {
+    return !Op::apply(state.vars[s->a], s->k);
+}
+template <class Op> bool x_check_kv(const eval_stmt* s, eval_state& state) {
+    return !Op::apply(s->k, state.vars[s->b]);
+}
+
+template <class Op> bool x_if_vv(const eval_stmt* s, eval_state& state) {
+    if (Op::apply(state.vars[s->a], state.vars[s->b]))
+        return exec_list(s->body, s->count, state);
+    return false;
+}
+template <class Op> bool x_if_vk(const eval_stmt* s, eval_state& state) {
+    if (Op::apply(state.vars[s->a], s->k))
+        return exec_list(s->body, s->count, state);
+    return false;
+}
+template <class Op> bool x_if_kv(const eval_stmt* s, eval_state& state) {
+    if (Op::apply(s->k, state.vars[s->b]))
+        return exec_list(s->body, s->count, state);
+    return false;
+}
+
+// the statement of type stmt doing Op on operands l and r, at most one literal
+template <class Op> exec_fn fused(token stmt, operand l, operand r) {
+    int shape = l == o_lit ? 2 : r == o_lit ? 1 : 0;
+    exec_fn assign[] = {x_assign_vv<Op>, x_assign_vk<Op>, x_assign_kv<Op>};
+    exec_fn check[] = {x_check_vv<Op>, x_check_vk<Op>, x_check_kv<Op>};
+    exec_fn branch[] = {x_if_vv<Op>, x_if_vk<Op>, x_if_kv<Op>};
+    return stmt == t_id ? assign[shape] : stmt == t_check ? check[shape] : branch[shape];
+}
+
+static exec_fn pick_fused(token stmt, token op, bool checked, operand l, operand r) {
+    switch (op) {
+        case t_add: return checked ? fused<op_checked_add>(stmt, l, r) : fused<op_add>(stmt, l, r);
+        case t_sub: return checked ? fused<op_checked_sub>(stmt, l, r) : fused<op_sub>(stmt, l, r);
+        case t_mul: return checked ? fused<op_checked_mul>(stmt, l, r) : fused<op_mul>(stmt, l, r);
+        case t_div: return fused<op_div>(stmt, l, r);
+        case t_eq: return fused<op_eq>(stmt, l, r);
+        case t_noteq: return fused<op_ne>(stmt, l, r);
+        case t_lt: return fused<op_lt>(stmt, l, r);
+        case t_gt: return fused<op_gt>(stmt, l, r);
+        case t_lte: return fused<op_le>(stmt, l, r);
+        case t_gte: return fused<op_ge>(stmt, l, r);
+        default: return NULL;
+    }
+}
+
+// counts the pair (statement run before, this one), then runs it
+static bool x_profile(const eval_stmt* s, eval_state& state) {
+    state.pairs[state.last * state.kinds + s->kind]++;
+    state.last = s->kind;
+    return s->real(s, state);
+}
+
+/*
+ * conversion from the AST, once per program; deques keep the nodes where
+ * they were put while more are added
+ */
+struct eval_code {
+    bool checked;
+    bool fuse;
+    range_info ranges;
+    map<string, int> slots;
+    deque<eval_expr> exprs;
+    deque<eval_stmt> stmts;
+    deque<vector<const eval_stmt*> > lists;
+
+    // statement kinds of the pair profile, by what they run: "assign e+v",
+    // "check v<v (fused)"; kind 0 is the start of the program
+    vector<string> kinds;
+    map<string, int> kind_index;
+};
+
+static int kind(eval_code& code, const string& name) {
+    map<string, int>::iterator found = code.kind_index.find(name);
+    if (found != code.kind_index.end())
+        return found->second;
+    code.kind_index[name] = code.kinds.size();
+    code.kinds.push_back(name);
+    return code.kinds.size() - 1;
+}
+
+static int slot(eval_code& code, const char* name) {
+    map<string, int>::iterator found = code.slots.find(name);
+    if (found != code.slots.end())
+        return found->second;
+    int n = code.slots.size();
+    code.slots[name] = n;
+    return n;
+}
+
+// an operator on two literals is worked out now, unless it fails at run time
+static bool literal_value(eval_code& code, bin_op* node, long long& v) {
+    if (node->type == t_literal) {
+        v = atoll(node->name);
+        return true;
+    }
+    if (node->type == t_id)
+        return false;
+    if (!node->l_child || !node->r_child) {
+        v = 0;          // left behind by error recovery, 0 like in SSA
+        return true;
+    }
+    if (node->l_child->type != t_literal || node->r_child->type != t_literal)
+        return false;
+
+    eval_fn fn = pick_operator(node->type, code.checked, o_var, o_var);
+    if (!fn)
+        return false;
+    long long operands[2] = {atoll(node->l_child->name), atoll(node->r_child->name)};
+    eval_expr e;
+    memset(&e, 0, sizeof(e));
+    e.b = 1;
+    try {
+        v = fn(&e, operands);
+    } catch (EvalException&) {
+        return false;
+    }
+    return true;
+}
+
+static operand operand_of(eval_code& code, bin_op* node) {
+    long long v;
+    if (node->type == t_id)
+        return o_var;
+    if (literal_value(code, node, v))
+        return o_lit;
+    return o_expr;
+}
+
+// what the pair profile calls the relation: its operator on v, k or e
+static string shape_name(eval_code& code, bin_op* node) {
+    const char* names = "vke";
+    operand shape = operand_of(code, node);
+    if (shape != o_expr)
+        return string(1, names[shape]);
+    return names[operand_of(code, node->l_child)] + string(node->name) + names[operand_of(code, node->r_child)];
+}
+
+static const eval_expr* convert_expr(eval_code& code, bin_op* node);
+
+// fills in the side of e the operand is on, as shape
+static void convert_operand(eval_code& code, eval_expr* e, bin_op* node, operand shape, bool left) {
+    switch (shape) {
+        case o_var:
+            (left ? e->a : e->b) = slot(code, node->name);
+            break;
+        case o_lit:
+            literal_value(code, node, e->k);
+            break;
+        case o_expr:
+            (left ? e->l : e->r) = convert_expr(code, node);
+            break;
+    }
+}
+
+static const eval_expr* convert_expr(eval_code& code, bin_op* node) {
+    code.exprs.push_back(eval_expr());
+    eval_expr* e = &code.exprs.back();
+    memset(e, 0, sizeof(*e));
+
+    operand shape = operand_of(code, node);
+    operand l = shape == o_expr ? operand_of(code, node->l_child) : o_lit;
+    operand r = shape == o_expr ? operand_of(code, node->r_child) : o_lit;
+    if (l == o_lit && r == o_lit)
+        r = o_expr;         // there is room for one literal
+    eval_fn fn = shape == o_expr ? pick_operator(node->type, code.checked, l, r) : NULL;
+    if (shape == o_var) {
+        e->fn = e_var;
+        e->a = slot(code, node->name);
+    } else if (!fn) {
+        e->fn = e_lit;
+        literal_value(code, node, e->k);
+    } else {
+        e->fn = fn;
+        convert_operand(code, e, node->l_child, l, true);
+        convert_operand(code, e, node->r_child, r, false);
+    }
+    return e;
+}
+
+static void convert_list(eval_code& code, st_list* sl, const eval_stmt* const*& body, size_t& count);
+
+// fills in a fused statement for rel, false if rel is not one operator on variables and a literal
+static bool fuse(eval_code& code, eval_stmt* x, token stmt, bin_op* rel) {
+    if (!code.fuse || operand_of(code, rel) != o_expr)
+        return false;
+    operand l = operand_of(code, rel->l_child);
+    operand r = operand_of(code, rel->r_child);
+    if (l == o_expr || r == o_expr || (l == o_lit && r == o_lit))
+        return false;
+
+    x->fn = pick_fused(stmt, rel->type, code.checked, l, r);
+    if (l == o_var)
+        x->a = slot(code, rel->l_child->name);
+    else
+        literal_value(code, rel->l_child, x->k);
+    if (r == o_var)
+        x->b = slot(code, rel->r_child->name);
+    else
+        literal_value(code, rel->r_child, x->k);
+    return x->fn != NULL;
+}
+
+// x := x + k, x := k + x and x := x - k
+static bool fuse_increment(eval_code& code, eval_stmt* x, st* s) {
+    bin_op* rel = s->rel;
+    if (!code.fuse || operand_of(code, rel) != o_expr || (rel->type != t_add && rel->type != t_sub))
+        return false;
+    operand l = operand_of(code, rel->l_child);
+    operand r = operand_of(code, rel->r_child);
+
+    bool left = l == o_var && r == o_lit && strcmp(rel->l_child->name, s->id) == 0;
+    bool right = rel->type == t_add && l == o_lit && r == o_var && strcmp(rel->r_child->name, s->id) == 0;
+    if (!left && !right)
+        return false;
+    literal_value(code, left ? rel->r_child : rel->l_child, x->k);
+    if (rel->type == t_sub) {
+        if (x->k == LLONG_MIN)
+            return false;
+        x->k = -x->k;
+    }
+    x->fn = code.checked ? x_inc_checked : x_inc;
+    return true;
+}
+
+static const eval_stmt* convert_stmt(eval_code& code, st* s) {
+    code.stmts.push_back(eval_stmt());
+    eval_stmt* x = &code.stmts.back();
+    memset(x, 0, sizeof(*x));
+    x->fn = x_none;
+
+    string name;
+    map<string, range>::iterator found;
+    switch (s->type) {
+        case t_id:
+            x->slot = slot(code, s->id);
+            name = "assign " + shape_name(code, s->rel);
+            if (fuse_increment(code, x, s))
+                name = "inc (fused)";
+            else if (fuse(code, x, t_id, s->rel))
+                name += " (fused)";
+            else {
+                x->fn = x_assign;
+                x->rel = convert_expr(code, s->rel);
+            }
+            break;
+        case t_read:
+            x->fn = x_read;
+            x->slot = slot(code, s->id);
+            found = code.ranges.variables.find(s->id);
+            x->narrow = found == code.ranges.variables.end() || strcmp(range_c_type(found->second), "int64_t") != 0;
+            name = "read";
+            break;
+        case t_write:
+            x->fn = x_write;
+            x->rel = convert_expr(code, s->rel);
+            name = "write " + shape_name(code, s->rel);
+            break;
+        case t_if:
+            name = "if " + shape_name(code, s->rel);
+            if (fuse(code, x, t_if, s->rel))
+                name += " (fused)";
+            else {
+                x->fn = x_if;
+                x->rel = convert_expr(code, s->rel);
+            }
+            convert_list(code, s->sl, x->body, x->count);
+            break;
+        case t_do:
+            x->fn = x_do;
+            convert_list(code, s->sl, x->body, x->count);
+            name = "do";
+            break;
+        case t_check:
+            name = "check " + shape_name(code, s->rel);
+            if (fuse(code, x, t_check, s->rel))
+                name += " (fused)";
+            else {
+                x->fn = x_check;
+                x->rel = convert_expr(code, s->rel);
+            }
+            break;
+        default:
+            name = "none";
+            break;
+    }
+    x->kind = kind(code, name);
+    return x;
+}
+
+static void convert_list(eval_code& code, st_list* sl, const eval_stmt* const*& body, size_t& count) {
+    vector<const eval_stmt*> list;
+    for (; sl != NULL; sl = sl->r_child)
+        if (sl->l_child)
+            list.push_back(convert_stmt(code, sl->l_child));
+    code.lists.push_back(vector<const eval_stmt*>());
+    code.lists.back().swap(list);
+    body = code.lists.back().data();
+    count = code.lists.back().size();
+}
+
+// most frequent first, the pairs that never happened left out
+static void print_pairs(const eval_code& code, const vector<long long>& pairs, ostream& out) {
+    vector<pair<long long, size_t> > order;
+    for (size_t i = 0; i < pairs.size(); i++)
+        if (pairs[i])
+            order.push_back(make_pair(-pairs[i], i));
+    sort(order.begin(), order.end());
+
+    out << "instruction pairs, most frequent first" << endl;
+    for (size_t i = 0; i < order.size() && i < 30; i++) {
+        size_t first = order[i].second / code.kinds.size(), second = order[i].second % code.kinds.size();
+        out << setw(14) << -order[i].first << "  " << code.kinds[first] << " -> " << code.kinds[second] << endl;
+    }
+}
+
+bool eval_program(st_list* root, const compile_options& options, FILE* in, FILE* out, ostream& diag,
+                  const eval_options& how) {
+    eval_code code;
+    code.checked = options.checked;
+    code.fuse = how.fuse;
+    analyze_ranges(root, code.ranges);
+    kind(code, "start");
+
+    const eval_stmt* const* body;
+    size_t count;
+    convert_list(code, root, body, count);
+    vector<long long> vars(code.slots.size() + 1, 0);
+
+    vector<long long> pairs;
+    if (how.pairs) {
+        pairs.resize(code.kinds.size() * code.kinds.size());
+        for (size_t i = 0; i < code.stmts.size(); i++) {
+            code.stmts[i].real = code.stmts[i].fn;
+            code.stmts[i].fn = x_profile;
+        }
+    }
+
+    eval_io* io = io_open(in, out);
+    eval_state state = {vars.data(), io, pairs.data(), (int) code.kinds.size(), 0};
+    bool ok = true;
+    try {
+        exec_list(body, count, state);
+    } catch (EvalException& e) {
+        ok = false;
+        io_flush(*io);
+        diag << e.what() << endl;
+    }
+    io_flush(*io);
+    delete io;
+
+    if (how.pairs)
+        print_pairs(code, pairs, *how.pairs);
+    return ok;
+}
+
+/*
+ * the naive evaluator: a switch on the node type at every node, variables
+ * in a map by name
+ */
+struct naive_state {
+    map<string, long long> vars;
+    bool checked;
+    eval_io* io;
+};
+
+static long long naive_expr(naive_state& state, bin_op* node) {
+    if (node->type == t_id)
+        return state.vars[node->name];
+    if (node->type == t_literal)
+        return atoll(node->name);
+    if (!node->l_child || !node->r_child)
+        return 0;
+
+    long long a = naive_expr(state, node->l_child);
+    long long b = naive_expr(state, node->r_child);
+    switch (node->type) {
+        case t_add: return state.checked ? op_checked_add::apply(a, b) : op_add::apply(a, b);
+        case t_sub: return state.checked ? op_checked_sub::apply(a, b) : op_sub::apply(a, b);
+        case t_mul: return state.checked ? op_checked_mul::apply(a, b) : op_mul::apply(a, b);
+        case t_div: return op_div::apply(a, b);
+        case t_eq: return a == b;
+        case t_noteq: return a != b;
+        case t_lt: return a < b;
+        case t_gt: return a > b;
+        case t_lte: return a <= b;
+        case t_gte: return a >= b;
+        default: return 0;
+    }
+}
+
+// true when a check left the innermost do
+static bool naive_list(naive_state& state, st_list* sl, const range_info& ranges) {
+    for (; sl != NULL; sl = sl->r_child) {
+        st* s = sl->l_child;
+        if (!s)
+            continue;
+
+        long long n;
+        map<string, range>::const_iterator found;
+        switch (s->type) {
+            case t_id:
+                state.vars[s->id] = naive_expr(state, s->rel);
+                break;
+            case t_read:
+                if (io_read(*state.io, n)) {
+                    found = ranges.variables.find(s->id);
+                    bool narrow = found == ranges.variables.end() || strcmp(range_c_type(found->second), "int64_t") != 0;
+                    state.vars[s->id] = narrow ? (long long) (int) n : n;
+                }
+                break;
+            case t_write:
+                io_write(*state.io, naive_expr(state, s->rel));
+                break;
+            case t_if:
+                if (naive_expr(state, s->rel) && naive_list(state, s->sl, ranges))
+                    return true;
+                break;
+            case t_do:
+                while (!naive_list(state, s->sl, ranges))
+                    ;
+                break;
+            case t_check:
+                if (!naive_expr(state, s->rel))
+                    return true;
+                break;
+            default:
+                break;
+        }
+    }
+    return false;
+}
+
+bool eval_program_naive(st_list* root, const compile_options& options, FILE* in, FILE* out, ostream& diag) {
+    range_info ranges;
+    analyze_ranges(root, ranges);
+
+    eval_io* io = io_open(in, out);
+
+    naive_state state;
+    state.checked = options.checked;
+    state.io = io;
+    bool ok = true;
+    try {
+        naive_list(state, root, ranges);
+    } catch (EvalException& e) {
+        ok = false;
+        io_flush(*io);
+        diag << e.what() << endl;
+    }
+    io_flush(*io);
+    delete io;
+    return ok;
+}
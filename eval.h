@@ -0,0 +1,49 @@
+#ifndef __EVAL_H
+#define __EVAL_H
+
+#include <iostream>
+#include <cstdio>
+#include "ast.h"
+#include "compile.h"
+
+/*
+ * running a program in process, without going through C (parse --eval)
+ *
+ * The AST is converted once into closures: every node becomes a function
+ * pointer picked for its operator and the shape of its operands (variable,
+ * literal, subexpression), and every variable a slot in a flat array, so
+ * running a node is one indirect call with no lookup by name.
+ *
+ * The program behaves like the C compileToC writes for it: 64 bit values
+ * that the range analysis keeps within their C types, reads like the
+ * generated runtime (a failed read leaves the variable as it was, an int
+ * variable keeps the low 32 bits), one number per line on output, and with
+ * options.checked the overflow trap. Variables read before they are set,
+ * undefined in C, are 0. Division by zero, a crash in C, stops the program
+ * with a message.
+ */
+
+/*
+ * superinstructions: an assignment, check or if whose relation is a single
+ * operator on variables and a literal does the operator itself, x := x + k
+ * is an increment (fuse turns both off, to measure them), and operators on
+ * two literals are worked out once. With pairs set, every statement run counts
+ * the pair (statement run before it, itself), by kind of statement, and the
+ * most frequent pairs are written there at the end: what to fuse next
+ */
+struct eval_options {
+    bool fuse;
+    std::ostream* pairs;
+
+    eval_options() : fuse(true), pairs(NULL) {}
+};
+
+// false if the program stopped on a run-time error, the message is on diag
+bool eval_program(st_list* root, const compile_options& options, FILE* in, FILE* out, std::ostream& diag,
+                  const eval_options& how = eval_options());
+
+// the same by walking the AST and looking variables up by name; the
+// reference eval_program is checked and benchmarked against
+bool eval_program_naive(st_list* root, const compile_options& options, FILE* in, FILE* out, std::ostream& diag);
+
+#endif
@@ -0,0 +1,110 @@
+#include "feedback.h"
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+const char* statement_name(token type) {
+    switch (type) {
+        case t_id: return "assign";
+        case t_read: return "read";
+        case t_write: return "write";
+        case t_if: return "if";
+        case t_do: return "do";
+        case t_check: return "check";
+        default: return "none";
+    }
+}
+
+typedef map<pair<int, string>, vector<stmt_counts> > report_lines;
+
+// report lines in order by place, the header and anything else that does not parse is skipped
+static void split_report(string_view report, report_lines& lines) {
+    while (!report.empty()) {
+        size_t end = report.find('\n');
+        string text(report.substr(0, end));
+        report = end == string_view::npos ? string_view() : report.substr(end + 1);
+
+        int line;
+        char what[16];
+        stmt_counts counts = {0, 0};
+        if (sscanf(text.c_str(), "%d %15s %llu %llu", &line, what, &counts.runs, &counts.taken) >= 3)
+            lines[make_pair(line, string(what))].push_back(counts);
+    }
+}
+
+struct matcher {
+    report_lines lines;
+    map<pair<int, string>, size_t> used;
+    profile_counts* counts;
+};
+
+static stmt_counts* match(matcher& m, const st* statement) {
+    pair<int, string> place(statement->line, statement_name(statement->type));
+    report_lines::iterator found = m.lines.find(place);
+    size_t& next = m.used[place];
+    if (found == m.lines.end() || next == found->second.size())
+        return NULL;
+    stmt_counts& counts = (*m.counts)[statement];
+    counts = found->second[next++];
+    return &counts;
+}
+
+// loop is the innermost do around sl, NULL at the top
+static void match_list(matcher& m, st_list* sl, const st* loop) {
+    for (; sl != NULL; sl = sl->r_child) {
+        st* statement = sl->l_child;
+        if (!statement)
+            continue;
+        stmt_counts* counts = match(m, statement);
+        if (counts && statement->type == t_check) {
+            profile_counts::iterator outer = loop ? m.counts->find(loop) : m.counts->end();
+            if (outer != m.counts->end())
+                counts->taken = outer->second.runs;
+            else
+                m.counts->erase(statement);
+        }
+        if (!statement->sl)
+            continue;
+        match_list(m, statement->sl, statement->type == t_do ? statement : loop);
+
+        if (counts && statement->type == t_if) {
+            st_list* body = statement->sl;
+            while (body && !body->l_child)
+                body = body->r_child;
+            profile_counts::iterator first = body ? m.counts->find(body->l_child) : m.counts->end();
+            if (first != m.counts->end())
+                counts->taken = first->second.runs;
+            else
+                m.counts->erase(statement);
+        }
+    }
+}
+
+size_t read_profile(string_view report, st_list* root, profile_counts& counts) {
+    matcher m;
+    m.counts = &counts;
+    split_report(report, m.lines);
+    match_list(m, root, NULL);
+    return counts.size();
+}
+
+int expected_branch(const profile_counts& counts, const st* statement) {
+    profile_counts::const_iterator found = counts.find(statement);
+    if (found == counts.end() || found->second.runs < 16)
+        return -1;
+    const stmt_counts& c = found->second;
+    if (c.taken * 10 <= c.runs)
+        return 0;
+    // a check exits once per run of its loop at most, its exit is never known to be likely
+    if (statement->type == t_if && c.taken * 10 >= c.runs * 9)
+        return 1;
+    return -1;
+}
+
+bool hot_loop(const profile_counts& counts, const st* loop) {
+    profile_counts::const_iterator found = counts.find(loop);
+    return found != counts.end() && found->second.runs > 0 && found->second.taken >= found->second.runs * 8;
+}
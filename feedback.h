@@ -0,0 +1,42 @@
+#ifndef __FEEDBACK_H
+#define __FEEDBACK_H
+
+#include <map>
+#include <string_view>
+#include "ast.h"
+
+/*
+ * profile feedback (parse --profile-use=report)
+ *
+ * report is what a --profile build of the same program wrote on stderr: one
+ * line per statement, "line statement runs [iterations]". Its lines are
+ * matched back to the statements by line and kind of statement, in order,
+ * so a report still fits a program edited elsewhere; statements without a
+ * line of their own get no hints.
+ */
+struct stmt_counts {
+    unsigned long long runs;
+    // if: runs of its body; do: iterations; check: at most this many exits,
+    // the runs of its do, as it leaves the loop once per run at most
+    unsigned long long taken;
+};
+
+typedef std::map<const st*, stmt_counts> profile_counts;
+
+// the names of statements in the report
+const char* statement_name(token type);
+
+// how many statements of root got counts from report
+size_t read_profile(std::string_view report, st_list* root, profile_counts& counts);
+
+/*
+ * what the counts say about a branch, from at least 16 runs: -1 nothing, 0 it
+ * is rarely taken (a tenth of the runs at most), 1 it mostly is. Taken is
+ * the body of an if, the exit of a check
+ */
+int expected_branch(const profile_counts& counts, const st* statement);
+
+// a do that makes 8 iterations per run or more, worth unrolling
+bool hot_loop(const profile_counts& counts, const st* loop);
+
+#endif
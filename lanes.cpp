@@ -0,0 +1,307 @@
+#include "lanes.h"
+#include "visit.h"
+#include <climits>
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+bool lanes_valid(int lanes) {
+    return lanes >= 1 && lanes <= 64 && (lanes & (lanes - 1)) == 0;
+}
+
+/*
+ * vector type, masks and I/O of the generated program; CALC_LANES and the
+ * lane type calc_lane are defined in front of it. A mask lane is -1 where
+ * the statement applies, 0 where it does not, what vector comparisons give
+ */
+static const char* lanes_runtime = R"(typedef calc_lane calc_vec __attribute__((vector_size(CALC_LANES * sizeof(calc_lane))));
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+#define CALC_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define CALC_CLONES
+#endif
+
+/*
+ * vectors go to functions by pointer: the clones would not agree on passing
+ * them in registers, and gcc warns about it wherever one goes by value
+ */
+#define calc_splat(v) ((calc_vec){0} + (calc_lane)(v))
+#define calc_select(m, a, b) (((a) & (m)) | ((b) & ~(m)))
+// inactive lanes hold anything, 0 / 1 does not trap
+#define calc_div(a, b, m) (((a) & (m)) / calc_select(m, b, calc_splat(1)))
+
+static inline int calc_any(const calc_vec* m) {
+    calc_lane any = 0;
+    for (int i = 0; i < CALC_LANES; i++)
+        any |= (*m)[i];
+    return any != 0;
+}
+
+// lane i reads from calc_at[i] up to calc_eol[i], the end of its input set's line, and writes to calc_row[i]
+static const char* calc_at[CALC_LANES];
+static const char* calc_eol[CALC_LANES];
+static char* calc_row[CALC_LANES];
+static size_t calc_row_len[CALC_LANES], calc_row_cap[CALC_LANES];
+
+// wide: the variable is int64_t, otherwise the number is cut to int as the plain program's read does
+static inline void calc_read_lanes(calc_vec* v, const calc_vec* m, int wide) {
+    for (int i = 0; i < CALC_LANES; i++) {
+        if (!(*m)[i])
+            continue;
+        const char* p = calc_at[i];
+        const char* end = calc_eol[i];
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\v' || *p == '\f'))
+            p++;
+        int negative = p < end && *p == '-';
+        if (p < end && (*p == '-' || *p == '+'))
+            p++;
+        if (p == end || *p < '0' || *p > '9') {
+            calc_at[i] = p < end ? p + 1 : p;
+            continue;
+        }
+        uint64_t n = 0;
+        do {
+            n = n * 10 + (*p++ - '0');
+        } while (p < end && *p >= '0' && *p <= '9');
+        calc_at[i] = p;
+        int64_t value = negative ? (int64_t) -n : (int64_t) n;
+        (*v)[i] = wide ? (calc_lane) value : (calc_lane) (int) value;
+    }
+}
+
+static inline void calc_write_lanes(const calc_vec* v, const calc_vec* m) {
+    for (int i = 0; i < CALC_LANES; i++) {
+        if (!(*m)[i])
+            continue;
+        if (calc_row_cap[i] - calc_row_len[i] < 24) {
+            calc_row_cap[i] = calc_row_cap[i] * 2 + 64;
+            calc_row[i] = realloc(calc_row[i], calc_row_cap[i]);
+            if (!calc_row[i])
+                abort();
+        }
+        char* out = calc_row[i] + calc_row_len[i];
+        char digits[24];
+        int d = 0;
+        int64_t value = (*v)[i];
+        uint64_t n = value < 0 ? -(uint64_t) value : (uint64_t) value;
+        if (calc_row_len[i])
+            *out++ = ' ';
+        if (value < 0)
+            *out++ = '-';
+        do {
+            digits[d++] = '0' + n % 10;
+            n /= 10;
+        } while (n);
+        while (d)
+            *out++ = digits[--d];
+        calc_row_len[i] = out - calc_row[i];
+    }
+}
+
+)";
+
+// the input sets CALC_LANES at a time through calc_program, their rows out in order
+static const char* lanes_driver = R"(
+static char calc_out[1 << 16];
+static size_t calc_out_len;
+
+static void calc_emit(const char* text, size_t size) {
+    if (calc_out_len + size > sizeof calc_out) {
+        fwrite(calc_out, 1, calc_out_len, stdout);
+        calc_out_len = 0;
+    }
+    if (size > sizeof calc_out) {
+        fwrite(text, 1, size, stdout);
+        return;
+    }
+    memcpy(calc_out + calc_out_len, text, size);
+    calc_out_len += size;
+}
+
+int main() {
+    size_t size = 0, capacity = 1 << 16, got;
+    char* text = malloc(capacity);
+    while (text && (got = fread(text + size, 1, capacity - size, stdin)) > 0) {
+        size += got;
+        if (size == capacity)
+            text = realloc(text, capacity *= 2);
+    }
+    if (!text)
+        abort();
+    const char* p = text;
+    const char* end = text + size;
+    while (p < end) {
+        calc_vec m = {0};
+        int sets = 0;
+        for (; sets < CALC_LANES && p < end; sets++) {
+            const char* eol = memchr(p, '\n', end - p);
+            if (!eol)
+                eol = end;
+            calc_at[sets] = p;
+            calc_eol[sets] = eol;
+            calc_row_len[sets] = 0;
+            m[sets] = -1;
+            p = eol == end ? end : eol + 1;
+        }
+        calc_program(&m);
+        for (int i = 0; i < sets; i++) {
+            calc_emit(calc_row[i], calc_row_len[i]);
+            calc_emit("\n", 1);
+        }
+    }
+    fwrite(calc_out, 1, calc_out_len, stdout);
+    return 0;
+}
+)";
+
+// every variable and every expression in int: twice the lanes in a register
+static bool fits_int32(const range_info& ranges) {
+    for (map<string, range>::const_iterator it = ranges.variables.begin(); it != ranges.variables.end(); it++)
+        if (!range_fits(it->second, INT_MIN, INT_MAX))
+            return false;
+    for (map<const bin_op*, range>::const_iterator it = ranges.nodes.begin(); it != ranges.nodes.end(); it++)
+        if (!range_fits(it->second, INT_MIN, INT_MAX))
+            return false;
+    return true;
+}
+
+/*
+ * the statements of calc_program: the mask of the top level is calc_m0, the
+ * input sets there are; an if or a do opens a block with the mask of its
+ * body, calc_m1 one level down and so on, closed by leave
+ */
+class lane_emitter : public ast_visitor<lane_emitter> {
+public:
+    lane_emitter(const range_info& ranges, ostream& out) : ranges(ranges), out(out) {}
+    bool enter(st* statement);
+    void leave(st* statement);
+
+    set<string> variables;
+private:
+    string mask() const { return open.empty() ? "calc_m0" : open.back(); }
+    bool opened(const string& mask);
+    string value(bin_op* node);
+    string condition(bin_op* node);
+    bool wide(const string& name);
+
+    const range_info& ranges;
+    ostream& out;
+    vector<string> open;    // masks of the bodies the walk is in
+};
+
+static bool comparison(token type) {
+    return type == t_eq || type == t_noteq || type == t_lt || type == t_gt || type == t_lte || type == t_gte;
+}
+
+// the source's <> is C's !=
+static string c_operator(bin_op* node) {
+    return node->type == t_noteq ? "!=" : node->name;
+}
+
+// the lanes of the expression, a comparison is 1 or 0 in each
+string lane_emitter::value(bin_op* node) {
+    if (!node->l_child || !node->r_child)
+        return node->type == t_literal ? "calc_splat(" + string(node->name) + ")" : string(node->name);
+    if (comparison(node->type))
+        return "(-" + condition(node) + ")";
+    // by a number other than 0 no lane traps, and gcc divides by shifts and multiplies instead of lane by lane
+    if (node->type == t_div && node->r_child->type == t_literal && atoll(node->r_child->name) != 0)
+        return "(" + value(node->l_child) + " / " + value(node->r_child) + ")";
+    if (node->type == t_div)
+        return "calc_div(" + value(node->l_child) + ", " + value(node->r_child) + ", " + mask() + ")";
+    return "(" + value(node->l_child) + " " + node->name + " " + value(node->r_child) + ")";
+}
+
+// the mask of the lanes where the expression holds
+string lane_emitter::condition(bin_op* node) {
+    if (node->l_child && node->r_child && comparison(node->type))
+        return "(" + value(node->l_child) + " " + c_operator(node) + " " + value(node->r_child) + ")";
+    return "(" + value(node) + " != calc_splat(0))";
+}
+
+bool lane_emitter::wide(const string& name) {
+    map<string, range>::const_iterator found = ranges.variables.find(name);
+    return found != ranges.variables.end() && !range_fits(found->second, INT_MIN, INT_MAX);
+}
+
+bool lane_emitter::opened(const string& mask) {
+    open.push_back(mask);
+    return true;
+}
+
+bool lane_emitter::enter(st* statement) {
+    string m = mask();
+    string inner = "calc_m" + to_string(open.size() + 1);
+
+    switch(statement->type) {
+        case t_id:
+            variables.insert(statement->id);
+            out << statement->id << " = calc_select(" << m << ", " << value(statement->rel) << ", "
+                << statement->id << ");" << endl;
+            break;
+        case t_read:
+            variables.insert(statement->id);
+            out << "calc_read_lanes(&" << statement->id << ", &" << m << ", " << wide(statement->id) << ");" << endl;
+            break;
+        case t_write:
+            out << "{" << endl;
+            out << "calc_vec calc_value = " << value(statement->rel) << ";" << endl;
+            out << "calc_write_lanes(&calc_value, &" << m << ");" << endl;
+            out << "}" << endl;
+            break;
+        case t_if:
+            out << "{" << endl;
+            out << "calc_vec " << inner << " = " << m << " & " << condition(statement->rel) << ";" << endl;
+            out << "if (calc_any(&" << inner << ")) {" << endl;
+            return opened(inner);
+        case t_do:
+            out << "{" << endl;
+            out << "calc_vec " << inner << " = " << m << ";" << endl;
+            out << "while (calc_any(&" << inner << ")) {" << endl;
+            return opened(inner);
+        case t_check:
+            // right in its do (the semantic check sees to that): the lanes failing it leave the do
+            out << m << " &= " << condition(statement->rel) << ";" << endl;
+            break;
+        default:
+            *diag_out << "wrong type" << endl;
+    }
+    return false;
+}
+
+void lane_emitter::leave(st*) {
+    open.pop_back();
+    out << "}" << endl << "}" << endl;
+}
+
+void compile_lanes(st_list* root, const compile_options& options, const range_info& ranges, ostream& out,
+                   ostream* ast) {
+    output_buffer statements;
+    lane_emitter emitter(ranges, statements);
+    if (ast) {
+        ast_printer printer(*ast);
+        fused_walk(root, NULL, printer, emitter);
+    } else {
+        emitter.walk(root, NULL);
+    }
+
+    out << "#include <stdio.h>" << endl;
+    out << "#include <stdlib.h>" << endl;
+    out << "#include <string.h>" << endl;
+    out << "#include <inttypes.h>" << endl << endl;
+    out << "#define CALC_LANES " << options.lanes << endl;
+    out << "typedef " << (fits_int32(ranges) ? "int32_t" : "int64_t") << " calc_lane;" << endl << endl;
+    out << lanes_runtime;
+    out << "CALC_CLONES" << endl;
+    out << "static void calc_program(const calc_vec* sets) {" << endl;
+    out << "calc_vec calc_m0 = *sets;" << endl;
+    for (set<string>::iterator it = emitter.variables.begin(); it != emitter.variables.end(); it++)
+        out << "calc_vec " << *it << " = {0};" << endl;
+    out << statements.str();
+    out << "}" << endl;
+    out << lanes_driver;
+}
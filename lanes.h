@@ -0,0 +1,43 @@
+#ifndef __LANES_H
+#define __LANES_H
+
+#include <iostream>
+#include "ast.h"
+#include "compile.h"
+#include "range.h"
+
+/*
+ * parse --lanes=N: C that runs the program on N input sets at once, one in
+ * each lane of a vector (gcc vector extensions)
+ *
+ * The input has one input set per line; a read takes the next number on its
+ * lane's line and keeps the variable as it was when the line has none left,
+ * as the plain program does at the end of its input. The output has a line
+ * per input set, in order, with the numbers that set wrote separated by
+ * spaces. Each set gets what the plain program gives it on its own.
+ *
+ * Every variable is a vector of N lanes, int32_t when the range analysis
+ * puts every variable and expression in int, int64_t otherwise. Statements
+ * run under a mask of the lanes they apply to: an assignment or a read
+ * changes those lanes only, an if narrows the mask by its condition and is
+ * skipped when no lane is left, a check takes the lanes that fail it out of
+ * the mask of its do, and a do runs while any lane is still in it.
+ * Division divides inactive lanes by 1, they may hold anything.
+ *
+ * The function running the lanes is built for AVX-512, AVX2 and the plain
+ * x86-64 instruction set (target_clones), the best the machine has is
+ * picked when the program starts; elsewhere the compiler lowers the vectors
+ * to what the target has. --lanes=1 is the scalar program in the same frame.
+ * More lanes than a register holds (8 int64_t or 16 int32_t with AVX-512,
+ * half that with AVX2) still work, but gcc compares them a lane at a time:
+ * 8 is the count to pick on AVX-512.
+ */
+
+// up to 64 lanes, a power of 2
+bool lanes_valid(int lanes);
+
+// the program; with ast its statements are printed there too, in the same walk (visit.h)
+void compile_lanes(st_list* root, const compile_options& options, const range_info& ranges, std::ostream& out,
+                   std::ostream* ast);
+
+#endif
@@ -0,0 +1,133 @@
+#include "loop.h"
+#include <cstring>
+#include <cstdlib>
+
+using namespace std;
+
+void collect_assigned(st_list* sl, set<string>& vars) {
+    for (; sl != NULL; sl = sl->r_child) {
+        if (!sl->l_child)
+            continue;
+        st* s = sl->l_child;
+        if (s->type == t_id || s->type == t_read)
+            vars.insert(s->id);
+        else if (s->type == t_if || s->type == t_do)
+            collect_assigned(s->sl, vars);
+    }
+}
+
+// no variable in node is assigned inside the loop
+bool invariant(bin_op* node, const set<string>& assigned) {
+    if (node->type == t_id)
+        return assigned.find(node->name) == assigned.end();
+    if (node->type == t_none)
+        return false;
+    if (node->l_child && !invariant(node->l_child, assigned))
+        return false;
+    if (node->r_child && !invariant(node->r_child, assigned))
+        return false;
+    return true;
+}
+
+static bool is_var(bin_op* node, const char* var) {
+    return node->type == t_id && strcmp(node->name, var) == 0;
+}
+
+static bool positive_literal(bin_op* node) {
+    return node->type == t_literal && atoll(node->name) > 0;
+}
+
+// nothing but assignments and ifs, down to the leaves
+static bool pure(st_list* sl, st_list* last) {
+    for (; sl != NULL && sl != last; sl = sl->r_child) {
+        if (!sl->l_child)
+            continue;
+        if (sl->l_child->type == t_if) {
+            if (!pure(sl->l_child->sl, NULL))
+                return false;
+        } else if (sl->l_child->type != t_id) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// the variable is assigned somewhere from sl up to last
+static bool assigns(st_list* sl, st_list* last, const char* var) {
+    for (; sl != NULL && sl != last; sl = sl->r_child) {
+        if (!sl->l_child)
+            continue;
+        st* s = sl->l_child;
+        if ((s->type == t_id || s->type == t_read) && strcmp(s->id, var) == 0)
+            return true;
+        if ((s->type == t_if || s->type == t_do) && assigns(s->sl, NULL, var))
+            return true;
+    }
+    return false;
+}
+
+bool recognize_counted_shape(st* loop, counted_loop& shape) {
+    st_list* body = loop->sl;
+    if (!body || !body->l_child || body->l_child->type != t_check)
+        return false;
+
+    // condition: i op N or N op i
+    bin_op* cond = body->l_child->rel;
+    token op = cond->type;
+    if (op != t_lt && op != t_lte && op != t_gt && op != t_gte)
+        return false;
+    if (!cond->l_child || !cond->r_child)
+        return false;
+
+    bin_op* bound;
+    if (cond->l_child->type == t_id) {
+        shape.var = cond->l_child->name;
+        shape.up = op == t_lt || op == t_lte;
+        bound = cond->r_child;
+    } else if (cond->r_child->type == t_id) {
+        shape.var = cond->r_child->name;
+        shape.up = op == t_gt || op == t_gte;
+        bound = cond->l_child;
+    } else {
+        return false;
+    }
+
+    // last statement of the body is the step
+    st_list* last = body;
+    while (last->r_child && last->r_child->l_child)
+        last = last->r_child;
+    if (last == body || last->l_child->type != t_id || strcmp(last->l_child->id, shape.var) != 0)
+        return false;
+
+    bin_op* step = last->l_child->rel;
+    if (!step->l_child || !step->r_child)
+        return false;
+    if (shape.up) {
+        bool var_plus_c = is_var(step->l_child, shape.var) && positive_literal(step->r_child);
+        bool c_plus_var = positive_literal(step->l_child) && is_var(step->r_child, shape.var);
+        if (step->type != t_add || !(var_plus_c || c_plus_var))
+            return false;
+    } else {
+        if (step->type != t_sub || !is_var(step->l_child, shape.var) || !positive_literal(step->r_child))
+            return false;
+    }
+    shape.stride = is_var(step->l_child, shape.var) ? step->r_child->name : step->l_child->name;
+
+    shape.check = body->l_child;
+    shape.step = last->l_child;
+    shape.first = body->r_child;
+    shape.last = last;
+    shape.bound = bound;
+    shape.inclusive = op == t_lte || op == t_gte;
+
+    if (assigns(shape.first, shape.last, shape.var))
+        return false;
+
+    set<string> assigned;
+    collect_assigned(body, assigned);
+    return invariant(bound, assigned);
+}
+
+bool recognize_counted_loop(st* loop, counted_loop& shape) {
+    return recognize_counted_shape(loop, shape) && pure(shape.first, shape.last);
+}
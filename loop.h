@@ -0,0 +1,38 @@
+#ifndef __LOOP_H
+#define __LOOP_H
+
+#include <set>
+#include <string>
+#include "ast.h"
+
+/*
+ * a do loop in counted shape
+ *
+ *   do check i < N         (<, <=, >, >=, i on either side)
+ *      ...                 assignments and ifs only, i is not assigned
+ *      i := i + c          (i - c when counting down), c a positive literal
+ *   od
+ *
+ * where nothing in N is assigned inside the loop
+ */
+struct counted_loop {
+    const char* var;        // induction variable
+    bool up;                // counts up, the step adds
+    st* check;              // first statement, the loop condition
+    st* step;               // last statement
+    st_list* first;         // body between them runs from here ...
+    st_list* last;          // ... up to, not including, this node
+    bin_op* bound;          // N
+    bool inclusive;         // <= or >=
+    const char* stride;     // c
+};
+
+bool recognize_counted_loop(st* loop, counted_loop& shape);
+
+// the same shape with anything between check and step, nested loops, I/O and checks too
+bool recognize_counted_shape(st* loop, counted_loop& shape);
+
+void collect_assigned(st_list* sl, std::set<std::string>& vars);
+bool invariant(bin_op* node, const std::set<std::string>& assigned);
+
+#endif
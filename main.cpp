@@ -0,0 +1,229 @@
+/* Command line driver: parse < program prints the AST and the semantic
+    report, and writes test.c when the program passes; parse --serve runs
+    the same pipeline for clients of a Unix socket.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include "parse.h"
+#include "astbin.h"
+#include "eval.h"
+#include "serve.h"
+#include "memstat.h"
+#include "pipeline.h"
+#include "batch.h"
+#include "trace.h"
+
+using namespace std;
+
+void usage() {
+    cerr << "usage: parse [--checked] [--ssa] [--loop-hints] [--stdio] [--profile] [--profile-use=report] [--openmp] [--no-closed-forms] [--lanes=N] [--jobs=N] [--pipeline] [--mem-stats] [--trace=file.json] [--emit-ast=file] < program" << endl;
+    cerr << "       parse [options] --from-ast=file" << endl;
+    cerr << "       parse [--checked] [--eval-pairs] --eval=program < input" << endl;
+    cerr << "       parse --serve <socket> [--workers <n>]" << endl;
+    cerr << "       parse [options] --batch=lib.so program...; parse --run=lib.so [name...]" << endl;
+    cerr << "  --checked    trap on integer overflow the range analysis cannot rule out" << endl;
+    cerr << "  --ssa        generate C from the SSA form (experimental, no faster than the default)" << endl;
+    cerr << "  --loop-hints mark counted loops with #pragma GCC ivdep/unroll" << endl;
+    cerr << "  --stdio      read and write with scanf/printf instead of the buffered runtime" << endl;
+    cerr << "  --profile    the program counts runs of each statement and loop iterations, reports on stderr" << endl;
+    cerr << "  --profile-use lay branches and loops out by such a report, see feedback.h" << endl;
+    cerr << "  --openmp     run counted loops with independent iterations on threads, build with gcc -fopenmp" << endl;
+    cerr << "  --no-closed-forms run counted loops with a closed form (scev.h) too" << endl;
+    cerr << "  --lanes=N    run N input sets at once, one per line of the input, in vector lanes, see lanes.h" << endl;
+    cerr << "  --jobs=N     print the AST and emit top-level statements on N threads, up to 64 (same output)" << endl;
+    cerr << "  --pipeline   read, scan, parse and print the AST on threads of their own, see pipeline.h" << endl;
+    cerr << "  --mem-stats  report heap, AST and output bytes by category and phase on stderr" << endl;
+    cerr << "  --trace      write a timeline of phases, statements and threads for chrome://tracing, see trace.h" << endl;
+    cerr << "  --emit-ast   also save the parsed program, see astbin.h" << endl;
+    cerr << "  --from-ast   start from a saved program instead of reading one" << endl;
+    cerr << "  --eval       run the program right away instead of writing C, see eval.h" << endl;
+    cerr << "  --eval-pairs then print which statements most often run one after the other" << endl;
+    cerr << "  --serve      answer requests on a Unix socket, see serve.h; --workers threads (default 4)" << endl;
+    cerr << "  --batch      compile the programs into one shared object with one gcc, cached, see batch.h" << endl;
+    cerr << "  --run        run programs of such a shared object by name, all of them without one" << endl;
+    exit (1);
+}
+
+int main (int argc, char* argv[]) {
+    compile_options options;
+    const char* socket_path = NULL;
+    const char* emit_ast = NULL;
+    const char* from_ast = NULL;
+    const char* eval_path = NULL;
+    const char* profile_path = NULL;
+    const char* batch_path = NULL;
+    const char* run_path = NULL;
+    const char* trace_path = NULL;
+    vector<string> operands;
+    bool mem_stats = false;
+    bool pipelined = false;
+    eval_options how;
+    int workers = 4;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc)
+            socket_path = argv[++i];
+        else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+            workers = atoi(argv[++i]);
+        else if (strncmp(argv[i], "--emit-ast=", 11) == 0 && argv[i][11])
+            emit_ast = argv[i] + 11;
+        else if (strncmp(argv[i], "--from-ast=", 11) == 0 && argv[i][11])
+            from_ast = argv[i] + 11;
+        else if (strncmp(argv[i], "--eval=", 7) == 0 && argv[i][7])
+            eval_path = argv[i] + 7;
+        else if (strncmp(argv[i], "--profile-use=", 14) == 0 && argv[i][14])
+            profile_path = argv[i] + 14;
+        else if (strcmp(argv[i], "--mem-stats") == 0)
+            mem_stats = true;
+        else if (strcmp(argv[i], "--pipeline") == 0)
+            pipelined = true;
+        else if (strcmp(argv[i], "--eval-pairs") == 0)
+            how.pairs = &cerr;
+        else if (strncmp(argv[i], "--trace=", 8) == 0 && argv[i][8])
+            trace_path = argv[i] + 8;
+        else if (strncmp(argv[i], "--batch=", 8) == 0 && argv[i][8])
+            batch_path = argv[i] + 8;
+        else if (strncmp(argv[i], "--run=", 6) == 0 && argv[i][6])
+            run_path = argv[i] + 6;
+        else if (argv[i][0] != '-')
+            operands.push_back(argv[i]);
+        else if (!parse_option(argv[i], options))
+            usage();
+    }
+
+    if (profile_path) {
+        ifstream report(profile_path);
+        if (!report) {
+            cerr << profile_path << ": cannot read" << endl;
+            return 1;
+        }
+        ostringstream text;
+        text << report.rdbuf();
+        options.profile_use = text.str();
+    }
+
+    string conflict = options_conflict(options);
+    if (!conflict.empty())
+        cerr << conflict << endl;
+    if (!conflict.empty() || (options.lanes && (eval_path || batch_path)))
+        usage();
+
+    // program files after --batch, names after --run, nothing else takes them
+    if ((!operands.empty() && !batch_path && !run_path) || (batch_path && (run_path || operands.empty())))
+        usage();
+    if (run_path)
+        return run_batch(run_path, operands, cerr);
+    if (batch_path) {
+        vector<batch_program> programs(operands.size());
+        for (size_t i = 0; i < operands.size(); i++) {
+            ifstream source(operands[i]);
+            if (!source) {
+                cerr << operands[i] << ": cannot read" << endl;
+                return 1;
+            }
+            ostringstream text;
+            text << source.rdbuf();
+            programs[i].name = batch_name(operands[i]);
+            programs[i].source = text.str();
+        }
+        ostringstream c;
+        bool cached;
+        if (!write_batch(programs, options, c, cerr) || !build_batch(c.str(), options, batch_path, cached, cerr))
+            return 1;
+        if (cached)
+            cerr << batch_path << ": from the cache" << endl;
+        return 0;
+    }
+
+    // before any thread starts
+    mem_tracking = mem_stats;
+
+    if (socket_path) {
+        if (workers < 1)
+            usage();
+        return serve(socket_path, workers);
+    }
+
+    parsed_program program;
+    if (eval_path) {
+        ifstream source(eval_path);
+        if (!source) {
+            cerr << eval_path << ": cannot read" << endl;
+            return 1;
+        }
+        ostringstream text, report;
+        text << source.rdbuf();
+        const string& program_text = text.str();
+        parse_program(program_text, cerr, options, program);
+        // only a program that would have been compiled is run
+        if (program.syntax_error || !semantic_analysis(program.semantics, report)) {
+            cerr << report.str();
+            return 1;
+        }
+        bool ran = eval_program(program.root, options, stdin, stdout, cerr, how);
+        if (mem_stats) {
+            mem_phase("running");
+            mem_count_names(program.root);
+            mem_report(cerr, count(program_text.begin(), program_text.end(), '\n'));
+        }
+        return ran ? 0 : 1;
+    }
+
+    // the front end and the compiler from here, before their threads start
+    if (trace_path)
+        trace_start();
+
+    size_t lines = 0;
+    parsed_ahead ahead;
+    if (from_ast) {
+        if (!load_ast_bin(from_ast, program, cerr))
+            return 1;
+    } else if (pipelined) {
+        parse_pipelined(stdin, cerr, program, ahead, lines);
+    } else {
+        ostringstream text;
+        {
+            trace_span span("read");
+            text << cin.rdbuf();
+        }
+        const string& source = text.str();
+        lines = count(source.begin(), source.end(), '\n');
+        parse_program(source, cerr, options, program);
+    }
+
+    if (emit_ast) {
+        ofstream saved(emit_ast, ios::binary);
+        write_ast_bin(program, saved);
+        if (!saved) {
+            cerr << emit_ast << ": cannot write" << endl;
+            return 1;
+        }
+    }
+
+    output_buffer c;
+    if (translate(program, cout, cout, c, options)) {
+        trace_span span("write test.c");
+        ofstream outputC("test.c");
+        outputC << c.str();
+    }
+
+    if (trace_path && !trace_write(trace_path)) {
+        cerr << trace_path << ": cannot write" << endl;
+        return 1;
+    }
+
+    if (mem_stats) {
+        mem_phase("writing test.c");
+        mem_count_names(program.root);
+        mem_report(cerr, lines);
+    }
+
+    return 0;
+}
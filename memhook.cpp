@@ -0,0 +1,80 @@
+#include "memstat.h"
+#include <cstdlib>
+#include <new>
+
+/*
+ * operator new and delete of the parse driver (see memstat.h): every block
+ * carries its size and the category it was charged to in front of it, so
+ * it is given back to the same category on whichever thread frees it.
+ * Blocks from before mem_tracking was set are charged to nothing.
+ */
+struct block_header {
+    size_t size;
+    size_t what;        // mem_categories: not counted
+};
+
+// the header keeps blocks aligned for any type, as malloc does
+static_assert(sizeof(block_header) % alignof(std::max_align_t) == 0, "misaligned blocks");
+
+static void* allocate(size_t size) {
+    block_header* block = (block_header*) malloc(sizeof(block_header) + size);
+    if (!block)
+        return NULL;
+    block->size = size;
+    block->what = mem_tracking ? mem_current() : mem_categories;
+    if (block->what != mem_categories)
+        mem_allocated((mem_category) block->what, size);
+    return block + 1;
+}
+
+static void release(void* p) {
+    if (!p)
+        return;
+    block_header* block = (block_header*) p - 1;
+    if (block->what != mem_categories)
+        mem_freed((mem_category) block->what, block->size);
+    free(block);
+}
+
+void* operator new(size_t size) {
+    void* p = allocate(size);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void operator delete(void* p) noexcept {
+    release(p);
+}
+
+void operator delete[](void* p) noexcept {
+    release(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    release(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    release(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    release(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    release(p);
+}
@@ -0,0 +1,208 @@
+#include "memstat.h"
+#include "ast.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+bool mem_tracking = false;
+
+static const char* const category_names[mem_categories] = {
+    "other", "tokens", "parse", "compile", "output", "arena", "st_list", "st", "bin_op"
+};
+
+/*
+ * counting is plain adds into counters of the thread's own: a thread takes
+ * a slot the first time it counts and keeps it, the report adds the slots
+ * up. A block freed on another thread than the one that allocated it takes
+ * the live bytes of the freeing slot below zero, the sum makes up for it
+ * (size_t wraps). The peak is of all threads together: each thread adds what
+ * it allocated and freed to a shared total every 64 KiB, so the peak may be
+ * that much short per thread
+ */
+static const int mem_slots = 256;       // threads beyond share the last one, with atomic adds
+static const long long mem_batch = 64 * 1024;
+
+struct mem_counter {
+    atomic<size_t> count;
+    atomic<size_t> bytes;
+    atomic<size_t> live;
+};
+
+struct mem_slot {
+    mem_counter counters[mem_categories];
+};
+
+// static, zero before any constructor runs: the allocator counts from the first block
+static mem_slot slots[mem_slots];
+static atomic<int> slots_taken;
+static atomic<long long> heap_live, heap_peak;
+
+struct mem_thread {
+    mem_slot* slot;
+    bool shared;
+    long long pending;          // heap bytes not added to heap_live yet
+};
+
+static thread_local mem_thread self = {NULL, false, 0};
+static thread_local mem_category current = mem_other;
+
+mem_scope::mem_scope(mem_category what) : saved(current) {
+    current = what;
+}
+
+mem_scope::~mem_scope() {
+    current = saved;
+}
+
+mem_category mem_current() {
+    return current;
+}
+
+static mem_counter& counter(mem_category what) {
+    if (!self.slot) {
+        int i = slots_taken.fetch_add(1, memory_order_relaxed);
+        self.shared = i >= mem_slots - 1;
+        self.slot = &slots[self.shared ? mem_slots - 1 : i];
+    }
+    return self.slot->counters[what];
+}
+
+// only this thread writes its slot, unless it shares one
+static void add(atomic<size_t>& value, size_t n) {
+    if (self.shared)
+        value.fetch_add(n, memory_order_relaxed);
+    else
+        value.store(value.load(memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+static void note_peak(long long live) {
+    long long peak = heap_peak.load(memory_order_relaxed);
+    while (live > peak && !heap_peak.compare_exchange_weak(peak, live, memory_order_relaxed))
+        ;
+}
+
+static void settle(long long bytes) {
+    self.pending += bytes;
+    if (self.pending < mem_batch && self.pending > -mem_batch)
+        return;
+    note_peak(heap_live.fetch_add(self.pending, memory_order_relaxed) + self.pending);
+    self.pending = 0;
+}
+
+// called from operator new: must not allocate
+void mem_allocated(mem_category what, size_t bytes) {
+    mem_counter& c = counter(what);
+    add(c.count, 1);
+    add(c.bytes, bytes);
+    add(c.live, bytes);
+    if (what < mem_st_list)
+        settle(bytes);
+}
+
+void mem_freed(mem_category what, size_t bytes) {
+    add(counter(what).live, -bytes);
+    if (what < mem_st_list)
+        settle(-(long long) bytes);
+}
+
+// the sum over the slots
+static size_t total(atomic<size_t> mem_counter::* field, int what) {
+    size_t sum = 0;
+    for (int i = 0; i < mem_slots; i++)
+        sum += (slots[i].counters[what].*field).load(memory_order_relaxed);
+    return sum;
+}
+
+struct mem_snapshot {
+    string name;
+    size_t live[mem_categories];
+    size_t heap;            // live heap bytes, the categories before mem_st_list
+};
+
+static mutex phases_lock;
+static vector<mem_snapshot> phases;
+static size_t name_arrays, name_bytes;
+
+void mem_phase(const char* name) {
+    if (!mem_tracking)
+        return;
+    // the snapshots are not what the phase used
+    mem_scope scope(mem_other);
+    mem_snapshot now;
+    now.name = name;
+    now.heap = 0;
+    for (int i = 0; i < mem_categories; i++) {
+        now.live[i] = total(&mem_counter::live, i);
+        if (i < mem_st_list)
+            now.heap += now.live[i];
+    }
+    note_peak(now.heap);
+    lock_guard<mutex> hold(phases_lock);
+    phases.push_back(now);
+}
+
+static void count_name(const char* name) {
+    name_arrays++;
+    name_bytes += strlen(name) + 1;
+}
+
+static void count_relation(bin_op* node) {
+    for (; node != NULL; node = node->r_child) {
+        count_name(node->name);
+        count_relation(node->l_child);
+    }
+}
+
+void mem_count_names(st_list* root) {
+    for (; root != NULL; root = root->r_child) {
+        st* statement = root->l_child;
+        if (!statement)
+            continue;
+        count_name(statement->id);
+        count_relation(statement->rel);
+        mem_count_names(statement->sl);
+    }
+}
+
+void mem_report(ostream& out, size_t lines) {
+    char line[160];
+    out << "memory: category allocations bytes live" << endl;
+    for (int i = 0; i < mem_categories; i++) {
+        snprintf(line, sizeof line, "  %-8s %12zu %14zu %14zu%s", category_names[i], total(&mem_counter::count, i),
+                 total(&mem_counter::bytes, i), total(&mem_counter::live, i), i >= mem_st_list ? "  (in the arena)" : "");
+        out << line << endl;
+    }
+    if (name_arrays > 0)
+        out << "memory: names " << name_arrays << " arrays of 100 bytes, " << name_bytes << " bytes used" << endl;
+
+    lock_guard<mutex> hold(phases_lock);
+    for (size_t p = 0; p < phases.size(); p++) {
+        out << "memory: live after " << phases[p].name << " " << phases[p].heap << " bytes (";
+        const char* separator = "";
+        for (int i = 0; i < mem_st_list; i++) {
+            if (phases[p].live[i] == 0)
+                continue;
+            out << separator << category_names[i] << " " << phases[p].live[i];
+            separator = ", ";
+        }
+        out << ")" << endl;
+    }
+
+    size_t live = 0, allocated = 0;
+    for (int i = 0; i < mem_st_list; i++) {
+        live += total(&mem_counter::live, i);
+        allocated += total(&mem_counter::bytes, i);
+    }
+    note_peak(live);
+    size_t peak = heap_peak.load(memory_order_relaxed);
+    out << "memory: peak " << peak << " bytes";
+    if (lines > 0)
+        out << ", " << peak / lines << " per source line, " << allocated / lines << " allocated per line over "
+            << lines << " lines";
+    out << endl;
+}
@@ -0,0 +1,79 @@
+#ifndef __MEMSTAT_H
+#define __MEMSTAT_H
+
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <cstddef>
+
+typedef struct _st_list st_list;
+
+/*
+ * memory accounting (parse --mem-stats)
+ *
+ * Heap blocks are counted by the allocator of the parse driver (memhook.cpp)
+ * and charged to the category of the innermost mem_scope of the thread that
+ * asks for them: the token arrays of the parallel scanner, the parser's
+ * follow sets, the compiler's sets, maps and strings, output buffers. Arena
+ * blocks are heap too, the AST nodes in them are counted by kind as
+ * ast_alloc hands them out. A program linking libcalc without memhook.o
+ * only sees the arena.
+ *
+ * Nothing is counted until mem_tracking is set, before any thread starts.
+ * Then every thread counts into a slot of its own (memstat.cpp), with plain
+ * relaxed loads and stores, no read-modify-write, past 255 threads into one
+ * shared slot with atomic adds; only the heap total behind the peak is
+ * shared, each thread adds to it every 64 KiB. mem_phase and mem_report sum
+ * the slots and may run on any thread, also while others count: a phase
+ * is then a snapshot of counts in flight, not torn values. mem_count_names
+ * is not synchronized, call it and mem_report from one thread once the
+ * others are done.
+ */
+enum mem_category {
+    mem_other, mem_tokens, mem_parse, mem_compile, mem_output, mem_arena,
+    // inside the arena blocks, not heap of their own
+    mem_st_list, mem_st, mem_bin_op,
+    mem_categories
+};
+
+extern bool mem_tracking;
+
+class mem_scope {
+public:
+    explicit mem_scope(mem_category what);
+    ~mem_scope();
+private:
+    mem_category saved;
+};
+
+mem_category mem_current();
+
+void mem_allocated(mem_category what, size_t bytes);
+void mem_freed(mem_category what, size_t bytes);
+
+// the live bytes of every category now, reported under name
+void mem_phase(const char* name);
+
+// how much of the 100 byte id and name arrays of the nodes under root holds a name
+void mem_count_names(st_list* root);
+
+// on out, one line per category, phase and total; lines > 0 adds bytes per source line
+void mem_report(std::ostream& out, size_t lines);
+
+// an allocator charging mem_output wherever it is used, for buffers of generated text
+template <class T>
+struct output_allocator : std::allocator<T> {
+    template <class U> struct rebind { typedef output_allocator<U> other; };
+
+    output_allocator() {}
+    template <class U> output_allocator(const output_allocator<U>&) {}
+
+    T* allocate(size_t n) {
+        mem_scope scope(mem_output);
+        return std::allocator<T>::allocate(n);
+    }
+};
+
+typedef std::basic_ostringstream<char, std::char_traits<char>, output_allocator<char> > output_buffer;
+
+#endif
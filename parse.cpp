@@ -8,16 +8,23 @@
 #include <iostream>
 #include <cstdlib>
 #include <cstring>
+#include <cctype>
+#include <cerrno>
+#include <climits>
 #include <stdio.h>
 #include <vector>
 #include <algorithm>
 #include <set>
+#include <sstream>
 
 #include "scan.h"
 #include "ast.h"
 #include "semantic.h"
 #include "debug.h"
 #include "compile.h"
+#include "parse.h"
+#include "lanes.h"
+#include "trace.h"
 
 using namespace std;
 
@@ -92,9 +99,9 @@ const char* print_names[] = {"read", "write", "id", "literal", "gets",
                              "if", "fi", "do", "od", "check",
                              "==", "<>", "<", ">", "<=", ">=", "none"};
 
-static token input_token;
+static thread_local token input_token;
 
-bool has_syntax_error = false;
+thread_local bool has_syntax_error = false;
 
 bool EPS(const char* symbol) {
     if (strcmp(symbol, "stmt_list") == 0
@@ -136,7 +143,7 @@ set<int> FIRST(const char* symbol) {
         return mo;
 
     else {
-        cerr << "error in FIRST" << endl;
+        *diag_out << "error in FIRST" << endl;
         set<int> empty;
         return empty;
     }
@@ -153,9 +160,10 @@ void check_for_error(const char* symbol, set<int> follow_set) {
     if (!(first_set.find(input_token) != first_set.end()
           || (EPS(symbol) && follow_set.find(input_token) != follow_set.end()))) {
         has_syntax_error = true;
-        cerr << "\nError at " << symbol << " around line: " << lineno << ", using context specific follow to settle." << endl;
+        trace_instant("check_for_error", lineno);
+        *diag_out << "\nError at " << symbol << " around line: " << lineno << ", using context specific follow to settle." << endl;
         do {
-            cerr << "Delete token: " << token_image << endl;
+            *diag_out << "Delete token: " << token_image << endl;
             input_token = scan();
 
         } while (!(first_set.find(input_token) != first_set.end()
@@ -168,7 +176,7 @@ void check_for_error(const char* symbol, set<int> follow_set) {
 
 
 void error () {
-    cerr << "syntax error around line: " << lineno << endl;
+    *diag_out << "syntax error around line: " << lineno << endl;
     exit (1);
 }
 
@@ -186,8 +194,9 @@ void match (token expected, bool print) {
     }
     else {
         has_syntax_error = true;
-        cerr << endl;
-        cerr << "match error around line: " << lineno << " , get " << token_image <<
+        trace_instant("match error", lineno);
+        *diag_out << endl;
+        *diag_out << "match error around line: " << lineno << " , get " << token_image <<
                 ", insert: " << names[expected] << endl;
         return;
     }
@@ -197,24 +206,28 @@ void program ();
 st_list* stmt_list (st_list* stList);
 st* stmt ();
 bin_op* relation (set<int>);
-void expr (bin_op*a, set<int>);
-void expr_tail(bin_op*, set<int>);
-void term (bin_op*, set<int>);
-void term_tail (bin_op*, set<int>);
-void factor_tail (bin_op*, set<int>);
-void factor (bin_op*, set<int>);
-void relation_op(bin_op*);
-void add_op (bin_op*);
-void mul_op (bin_op*);
-
-void add_or_create_swap_node(bin_op* binary_op, token tok);
-
-st_list* pg_sl_root;
+bin_op* expr (int min_prec, set<int>);
+bin_op* climb (int min_prec, set<int>&);
+bin_op* factor (set<int>&);
+
+thread_local st_list* pg_sl_root;
+thread_local semantic_state semantics;
+static thread_local statement_hook top_level_hook;
+static thread_local void* hook_context;
+
+// an empty list: a statement list always ends in a node with no statement
+st_list* new_st_list() {
+    st_list* sl = (st_list*) ast_alloc(sizeof(st_list), mem_st_list);
+    sl->l_child = NULL;
+    sl->r_child = NULL;
+    return sl;
+}
 
 void program () {
-    pg_sl_root = (st_list*) malloc(sizeof(st_list));
-    pg_sl_root->l_child = NULL;
-    pg_sl_root->r_child = NULL;
+    semantic_mark start = semantic_position(semantics);
+    pg_sl_root = new_st_list();
+    if (top_level_hook)
+        top_level_hook(NULL, hook_context);
 
     AST("(program" << endl);
 	try{
@@ -234,27 +247,28 @@ void program () {
 				match (t_eof, false);
 				break;
 			default:
-				cerr << "Deleting token: " << token_image << endl;
+				*diag_out << "Deleting token: " << token_image << endl;
 				throw StatementlistException();
 		}
-	} catch (StatementlistException ste) {
-        cerr << ste.what() << " , line number: " << lineno << ", delete: " << token_image << endl;
-
-		free(pg_sl_root);
+	} catch (StatementlistException& ste) {
+        trace_instant("recover program", lineno);
+        *diag_out << ste.what() << " , line number: " << lineno << ", delete: " << token_image << endl;
+        semantic_unwind(semantics, 0);
 
 		while ((input_token = scan())) {
 			// recover
 			if (find(first_S.begin(), first_S.end(), input_token) != first_S.end()) {
-				//cerr << "line: " << lineno << ", token: " << token_image << " in first set" << endl;
+				//*diag_out << "line: " << lineno << ", token: " << token_image << " in first set" << endl;
+				semantic_rewind(semantics, start);
 				program();
 				input_token = scan();
 				return;
 			} else if (find(follow_S.begin(), follow_S.end(), input_token) != follow_S.end()) {
-				//cerr << "line: " << lineno << ", token: " << token_image << " in follow set" << endl;
+				//*diag_out << "line: " << lineno << ", token: " << token_image << " in follow set" << endl;
 				input_token = scan();
 				return;
 			} else {
-				cerr << "deleting token: " << token_image << ", error around line: " << lineno << endl;
+				*diag_out << "deleting token: " << token_image << ", error around line: " << lineno << endl;
 				input_token = scan();
 
 				if (input_token == t_eof)
@@ -266,9 +280,10 @@ void program () {
 }
 
 // stList is decided on the caller
+// one iteration per statement, a recursion per statement runs out of stack on long programs
 st_list* stmt_list (st_list* stList) {
-    st_list* new_sl;
-
+    bool top_level = stList == pg_sl_root;
+    for (;;) {
 	switch (input_token) {
 		/* First(stmt_list) */
 		case t_id:
@@ -280,39 +295,43 @@ st_list* stmt_list (st_list* stList) {
 			PREDICT("predict stmt_list --> stmt stmt_list");
 
 			AST("(");
-			stList->l_child = stmt ();
+			{
+				trace_span span(top_level ? "statement" : NULL, token_line);
+				stList->l_child = stmt ();
+			}
 			AST(")" << endl);
+			if (top_level && top_level_hook)
+				top_level_hook(stList->l_child, hook_context);
 
-			new_sl = (st_list*) malloc(sizeof(st_list));
-			new_sl->l_child = NULL;
-			new_sl->r_child = NULL;
-
-			stList->r_child = new_sl;
+			stList->r_child = new_st_list();
 			stList = stList->r_child;
-
-
-			stmt_list (stList);
 			break;
 			/* Follow(stmt_list) has (Follow(stmt) and Follow(R)) */
 		case t_eof:
 		case t_fi:
 		case t_od:
 			PREDICT("predict stmt_list --> epsilon" << endl);
-			break;          /*  epsilon production */
+			return stList;          /*  epsilon production */
 		default:
-			cerr << "Deleting token: " << token_image << endl;
+			*diag_out << "Deleting token: " << token_image << endl;
 			throw StatementlistException();
 	}
-	return stList;
+    }
 }
 
 st* stmt () {
-    bin_op* root;
     bin_op* rel;
-    st_list* stList;
-    st* statement = (st*) malloc(sizeof(st));
     st_list* sl_root;       // do and if
     set<int> follow_set;
+    size_t depth = semantics.open.size();
+
+    // what error recovery returns if the statement is abandoned half way
+    st* statement = (st*) ast_alloc(sizeof(st), mem_st);
+    statement->type = t_none;
+    statement->line = token_line;
+    statement->id[0] = '\0';
+    statement->rel = NULL;
+    statement->sl = NULL;
 
     try {
         switch (input_token) {
@@ -375,8 +394,10 @@ st* stmt () {
                 rel = relation(follow_set);
                 AST(endl << "[ ");
 
-                sl_root = (st_list*) malloc(sizeof(st_list));
+                sl_root = new_st_list();
+                semantic_open_if(semantics);
                 stmt_list (sl_root);
+                semantic_close(semantics);
 
                 statement->type = t_if;
                 statement->rel = rel;
@@ -392,8 +413,10 @@ st* stmt () {
                 AST("do\n");
                 AST("[ ");
 
-                sl_root = (st_list*) malloc(sizeof(st_list));
+                sl_root = new_st_list();
+                semantic_open_do(semantics);
                 stmt_list (sl_root);
+                semantic_close(semantics);
                 AST("]" << endl);
 
                 statement->type = t_do;
@@ -406,6 +429,7 @@ st* stmt () {
             case t_check:
                 PREDICT("predict stmt --> check R" << endl);
                 match (t_check, false);
+                semantic_check(semantics);
                 AST("check");
 
                 follow_set = follow_S;
@@ -419,26 +443,28 @@ st* stmt () {
 
                 break;
             default:
-                cerr << "Deleting token: " << token_image << endl;
+                *diag_out << "Deleting token: " << token_image << endl;
                 throw StatementException();
         }
-    } catch (StatementException se) {
-        cerr << se.what() << " , line number: " << lineno << ", delete: " << token_image << endl;
+    } catch (StatementException& se) {
+        trace_instant("recover statement", lineno);
+        *diag_out << se.what() << " , line number: " << lineno << ", delete: " << token_image << endl;
         has_syntax_error = true;
+        semantic_unwind(semantics, depth);
 
         while ((input_token = scan())) {
             // recover
             if (find(first_S.begin(), first_S.end(), input_token) != first_S.end()) {
-                //cerr << "line: " << lineno << ", token: " << token_image << " in first set" << endl;
+                //*diag_out << "line: " << lineno << ", token: " << token_image << " in first set" << endl;
                 stmt();
                 input_token = scan();
                 return statement;
             } else if (find(follow_S.begin(), follow_S.end(), input_token) != follow_S.end()) {
-                //cerr << "line: " << lineno << ", token: " << token_image << " in follow set" << endl;
+                //*diag_out << "line: " << lineno << ", token: " << token_image << " in follow set" << endl;
                 input_token = scan();
                 return statement;
             } else {
-                cerr << "deleting token: " << token_image << ", error around line: " << lineno << endl;
+                *diag_out << "deleting token: " << token_image << ", error around line: " << lineno << endl;
                 input_token = scan();
 
                 if (input_token == t_eof)
@@ -449,266 +475,172 @@ st* stmt () {
     return statement;
 }
 
-// init with null binary_op and return filled binary_op
-bin_op* relation(set<int> follow_set) {
-    bin_op* binary_op = (bin_op*) malloc(sizeof(bin_op));
-    binary_op->type = t_none;
-    binary_op->l_child = NULL;
-    binary_op->r_child = NULL;
+/*
+ * precedence climbing engine for R, E, T and F
+ *
+ * R -> E ET, E -> T TT and T -> F FT only differ in which operators they
+ * accept, so they are folded into one loop driven by operator precedence.
+ * Every operator allocates exactly one node and the tree is built bottom up,
+ * so a chain of n operators costs O(n) and comes out left associative:
+ * a - b - c is (- (- a b) c).
+ */
+enum Precedence {
+    p_none, p_relation, p_add, p_mul
+};
 
+int precedence(token tok) {
+    switch (tok) {
+        case t_eq:
+        case t_noteq:
+        case t_lt:
+        case t_gt:
+        case t_lte:
+        case t_gte:
+            return p_relation;
+        case t_add:
+        case t_sub:
+            return p_add;
+        case t_mul:
+        case t_div:
+            return p_mul;
+        default:
+            return p_none;
+    }
+}
+
+bin_op* new_bin_op(token type, const char* name, bin_op* l_child, bin_op* r_child) {
+    bin_op* node = (bin_op*) ast_alloc(sizeof(bin_op), mem_bin_op);
+    node->type = type;
+    strcpy(node->name, name);
+    node->l_child = l_child;
+    node->r_child = r_child;
+    return node;
+}
+
+// placeholder for an operand that error recovery could not salvage
+bin_op* empty_bin_op() {
+    return new_bin_op(t_none, "", NULL, NULL);
+}
+
+bin_op* relation(set<int> follow_set) {
     try {
         switch (input_token) {
             case t_id:
             case t_literal:
             case t_lparen:
                 PREDICT("predict relation --> expr expr_tail" << endl);
-                expr (binary_op, follow_set);
-                expr_tail (binary_op, follow_set);
-                break;
+                return expr (p_relation, follow_set);
             default:
-                //cerr << "Deleting token: " << token_image << endl;
+                //*diag_out << "Deleting token: " << token_image << endl;
                 throw RelationException();
         }
     } catch (RelationException &re) {
-        cerr << re.what() << " , line number: " << lineno << ", delete: " << token_image << endl;
+        trace_instant("recover relation", lineno);
+        *diag_out << re.what() << " , line number: " << lineno << ", delete: " << token_image << endl;
         has_syntax_error = true;
 
         while ((input_token = scan())) {
             // recover
             if (find(first_R.begin(), first_R.end(), input_token) != first_R.end()) {
-                //cerr << "line: " << lineno << ", token: " << token_image << " in first set" << endl;
-                expr(binary_op, follow_set);
-                return binary_op;
+                //*diag_out << "line: " << lineno << ", token: " << token_image << " in first set" << endl;
+                return expr(p_add, follow_set);
             } else if (find(follow_R.begin(), follow_R.end(), input_token) != follow_R.end()) {
-                //cerr << "line: " << lineno << ", token: " << token_image << " in follow set" << endl;
-                return binary_op;
+                //*diag_out << "line: " << lineno << ", token: " << token_image << " in follow set" << endl;
+                return empty_bin_op();
             } else {
-                cerr << "deleting token: " << token_image << ", error around line: " << lineno << endl;
+                *diag_out << "deleting token: " << token_image << ", error around line: " << lineno << endl;
                 input_token = scan();
 
                 if (input_token == t_eof)
-                    return binary_op;
+                    return empty_bin_op();
             }
         }
     }
-    return binary_op;
+    return empty_bin_op();
 }
 
-void expr (bin_op* binary_op, set<int> follow_set) {
+// parse operators of at least min_prec, recovering from errors in the operands
+bin_op* expr (int min_prec, set<int> follow_set) {
+    // what may legally follow an operand: the context follow set or another operator
+    set<int> operand_follow = follow_set;
+    operand_follow.insert(ro.begin(), ro.end());
+    operand_follow.insert(ao.begin(), ao.end());
+    operand_follow.insert(mo.begin(), mo.end());
+
     try {
         switch (input_token) {
             case t_id:
             case t_literal:
             case t_lparen:
                 PREDICT("predict expr --> term term_tail" << endl);
-                term (binary_op, follow_set);
-                term_tail (binary_op, follow_set);
-                break;
+                return climb (min_prec, operand_follow);
             default:
-                //cerr << "Deleting token: " << token_image << endl;
+                //*diag_out << "Deleting token: " << token_image << endl;
                 throw ExpressionException();
         }
     } catch (ExpressionException& ee) {
-        cerr << endl << ee.what() << ": error around line number: " << lineno << ", delete token: " << token_image << endl;
+        trace_instant("recover expression", lineno);
+        *diag_out << endl << ee.what() << ": error around line number: " << lineno << ", delete token: " << token_image << endl;
         has_syntax_error = true;
 
         while ((input_token = scan())) {
             // recover
             if (find(first_E.begin(), first_E.end(), input_token) != first_E.end()) {
-                //cerr << "line: " << lineno << ", token: " << token_image << " in first set" << endl;
-                expr(binary_op, follow_set);
-                return;
+                //*diag_out << "line: " << lineno << ", token: " << token_image << " in first set" << endl;
+                return expr(min_prec, follow_set);
             } else if (find(follow_E.begin(), follow_E.end(), input_token) != follow_E.end()) {
-                //cerr << "line: " << lineno << ", token: " << token_image << " in follow set" << endl;
-                return;
+                //*diag_out << "line: " << lineno << ", token: " << token_image << " in follow set" << endl;
+                return empty_bin_op();
             } else {
-                cerr << "deleting token: " << token_image << ", error around line: " << lineno << endl;
+                *diag_out << "deleting token: " << token_image << ", error around line: " << lineno << endl;
                 input_token = scan();
 
                 if (input_token == t_eof)
-                    return;
+                    return empty_bin_op();
             }
         }
     }
+    return empty_bin_op();
 }
 
-void expr_tail(bin_op* binary_op, set<int> follow_set) {
-    follow_set.insert(ro.begin(), ro.end());
-    check_for_error(__FUNCTION__, follow_set);
+// the right operand only takes operators binding tighter than op,
+// so the loop here is what makes the chain left associative
+bin_op* climb (int min_prec, set<int>& follow_set) {
+    bin_op* lhs = factor (follow_set);
 
-    switch (input_token) {
-        case t_eq:
-        case t_noteq:
-        case t_lt:
-        case t_gt:
-        case t_lte:
-        case t_gte:
-            relation_op(binary_op);
-            expr(binary_op, follow_set);
-            break;
-        /* Follow(E) */
-        case t_eof:
-        case t_id:
-        case t_read:
-        case t_write:
-        case t_if:
-        case t_fi:
-        case t_do:
-        case t_od:
-        case t_check:
-        case t_rparen:
-            PREDICT("predict expr_tail --> epsilon" << endl);
+    while (true) {
+        int prec = precedence(input_token);
+        if (prec == p_none || prec < min_prec)
             break;
-        default:
-            //cerr << "Deleting token: " << token_image << endl;
-            throw ExpressionException();
-    }
-}
 
-void term (bin_op* binary_op, set<int> follow_set) {
-    switch (input_token) {
-        case t_id:
-        case t_literal:
-        case t_lparen:
-            PREDICT("predict term --> factor factor_tail" << endl);
-            factor (binary_op, follow_set);
-            factor_tail (binary_op, follow_set);
-            break;
-        default:
-            //cerr << "Deleting token: " << token_image << endl;
-            throw ExpressionException();
-    }
-}
+        token op = input_token;
+        PREDICT("predict " << print_names[op] << " at precedence " << prec << endl);
+        match (op, false);
 
-void term_tail (bin_op* binary_op, set<int> follow_set) {
-    follow_set.insert(ao.begin(), ao.end());
-    follow_set.insert(ro.begin(), ro.end());
-    check_for_error(__FUNCTION__, follow_set);
+        bin_op* rhs = climb (prec + 1, follow_set);
+        lhs = new_bin_op(op, print_names[op], lhs, rhs);
 
-    switch (input_token) {
-        case t_add:
-        case t_sub:
-            PREDICT("predict term_tail --> add_op term term_tail" << endl);
-            add_op (binary_op);
-            term (binary_op, follow_set);
-            term_tail (binary_op, follow_set);
+        // ET -> ro E | epsilon, relations do not chain
+        if (prec == p_relation)
             break;
-        case t_rparen:
-        case t_id:
-        case t_read:
-        case t_write:
-        case t_eof:
-        case t_eq:
-        case t_noteq:
-        case t_gt:
-        case t_lt:
-        case t_gte:
-        case t_lte:
-        case t_if:
-        case t_fi:
-        case t_do:
-        case t_od:
-        case t_check:
-                PREDICT("predict term_tail --> epsilon" << endl);
-                break;          /*  epsilon production */
-            //}
-        default:
-            //cerr << "Deleting token: " << token_image << endl;
-            throw ExpressionException();
     }
+    return lhs;
 }
 
-void factor_tail (bin_op* binary_op, set<int> follow_set) {
-    follow_set.insert(ao.begin(), ao.end());
-    follow_set.insert(ro.begin(), ro.end());
-    follow_set.insert(mo.begin(), mo.end());
-    check_for_error(__FUNCTION__, follow_set);
-
-    switch (input_token) {
-        case t_mul:
-        case t_div:
-            PREDICT("predict factor_tail --> mul_op factor factor_tail" << endl);
-            mul_op (binary_op);
-            factor (binary_op, follow_set);
-            factor_tail (binary_op, follow_set);
-            break;
-        /* Follow(factor_tail) */
-        case t_add:
-        case t_sub:
-        case t_rparen:
-        case t_id:
-        case t_read:
-        case t_write:
-        case t_eof:
-        case t_eq:
-        case t_noteq:
-        case t_gt:
-        case t_lt:
-        case t_gte:
-        case t_lte:
-        case t_if:
-        case t_fi:
-        case t_do:
-        case t_od:
-        case t_check:
-                PREDICT("predict factor_tail --> epsilon" << endl);
-                break;          /*  epsilon production */
-            //}
-        default:
-            //cerr << "Deleting token: " << token_image << endl;
-            throw ExpressionException();
-    }
-}
-
-void add_child_to_null_node(bin_op* root, bin_op *child) {
-    if (!root)
-        return;
-    else {
-        if (root->l_child == NULL) {
-            root->l_child = child;
-        }
-        else if (root->r_child == NULL) {
-            root->r_child = child;
-        }
-        else {
-            // TODO
-            add_child_to_null_node(root->r_child, child);
-        }
-    }
-}
-
-void factor (bin_op* binary_op, set<int> follow_set) {
+bin_op* factor (set<int>& follow_set) {
     bin_op* child;
     set<int> follow_set_for_paren;
 
     switch (input_token) {
         case t_id :
             PREDICT("predict factor --> id" << endl);
-
-            child = (bin_op *) malloc(sizeof(bin_op));
-            child->type = t_id;
-            strcpy(child->name, token_image);
-            child->l_child = NULL;
-            child->r_child = NULL;
-
+            child = new_bin_op(t_id, token_image, NULL, NULL);
             match (t_id, false);
-
-            add_child_to_null_node(binary_op, child);
-
             break;
         case t_literal:
             PREDICT("predict factor --> literal" << endl);
-
-            child = (bin_op *) malloc(sizeof(bin_op));
-            child->type = t_literal;
-            strcpy(child->name, token_image);
-            child->l_child = NULL;
-            child->r_child = NULL;
-
+            child = new_bin_op(t_literal, token_image, NULL, NULL);
             match (t_literal, false);
-
-            add_child_to_null_node(binary_op, child);
-
             break;
         case t_lparen:
             PREDICT("predict factor --> lparen expr rparen" << endl);
@@ -717,143 +649,148 @@ void factor (bin_op* binary_op, set<int> follow_set) {
             follow_set_for_paren.insert(t_rparen);
             child = relation (follow_set_for_paren);
 
-            // find null child
-            add_child_to_null_node(binary_op, child);
-
             match (t_rparen, false);
             break;
         default:
-            //cerr << "Deleting token: " << token_image << endl;
+            //*diag_out << "Deleting token: " << token_image << endl;
             throw ExpressionException();
     }
-}
-
-// if bin_op's type is not t_none
-// create a new node and swap it with the right node
-void add_or_create_swap_node(bin_op* binary_op, token tok) {
-    if (binary_op->type == t_none) {
-        binary_op->type = tok;
-        strcpy(binary_op->name, print_names[tok]);
-    } else {
-        bin_op* new_node = (bin_op*) malloc(sizeof(bin_op));
-        new_node->type = tok;
-        new_node->r_child = NULL;
-        strcpy(new_node->name, print_names[tok]);
-
-        new_node->l_child = binary_op->r_child;
-        binary_op->r_child = new_node;
-    }
-}
-
-void relation_op(bin_op* binary_op) {
-    switch (input_token) {
-        case t_eq:
-            PREDICT("predict relation_op --> ==" << endl);
-            match (t_eq, false);
-
-            add_or_create_swap_node(binary_op, t_eq);
-
-            break;
-        case t_noteq:
-            PREDICT("predict relation_op --> <>" << endl);
-            match (t_noteq, false);
-
-            add_or_create_swap_node(binary_op, t_noteq);
-
-            break;
-        case t_lt:
-            PREDICT("predict relation_op --> <" << endl);
-            match (t_lt, false);
-
-            add_or_create_swap_node(binary_op, t_lt);
-
-            break;
-        case t_gt:
-            PREDICT("predict relation_op --> >" << endl);
-            match (t_gt, false);
-
-            add_or_create_swap_node(binary_op, t_gt);
-
-            break;
-        case t_lte:
-            PREDICT("predict relation_op --> <=" << endl);
-            match (t_lte, false);
-
-            add_or_create_swap_node(binary_op, t_lte);
 
-            break;
-        case t_gte:
-            PREDICT("predict relation_op --> >=" << endl);
-            match (t_gte, false);
-
-            add_or_create_swap_node(binary_op, t_gte);
+    // same role as the old factor_tail: an operand must be followed by an operator or Follow(E)
+    check_for_error("factor_tail", follow_set);
+    if (precedence(input_token) == p_none && follow_E.find(input_token) == follow_E.end())
+        throw ExpressionException();
 
-            break;
-        default:
-            //cerr << "Deleting token: " << token_image << endl;
-            throw ExpressionException();
-    }
+    return child;
 }
 
-void add_op (bin_op* binary_op) {
-    switch (input_token) {
-        case t_add:
-            PREDICT("predict add_op --> add" << endl);
-            match (t_add, false);
-
-            add_or_create_swap_node(binary_op, t_add);
-
-            break;
-        case t_sub:
-            PREDICT("predict add_op --> sub" << endl);
-            match (t_sub, false);
-
-            add_or_create_swap_node(binary_op, t_sub);
-
-            break;
-        default:
-            //cerr << "Deleting token: " << token_image << endl;
-            throw ExpressionException();
-    }
+// the number text spells, -1 unless it is all digits and fits an int
+static int option_number(const char* text) {
+    char* end;
+    errno = 0;
+    long n = strtol(text, &end, 10);
+    if (!isdigit((unsigned char) *text) || *end || errno || n > INT_MAX)
+        return -1;
+    return (int) n;
 }
 
-void mul_op (bin_op* binary_op) {
-    switch (input_token) {
-        case t_mul:
-            PREDICT("predict mul_op --> mul" << endl);
-            match (t_mul, false);
-
-            add_or_create_swap_node(binary_op, t_mul);
+bool parse_option(const char* arg, compile_options& options) {
+    if (strcmp(arg, "--checked") == 0)
+        options.checked = true;
+    else if (strcmp(arg, "--ssa") == 0)
+        options.ssa = true;
+    else if (strcmp(arg, "--loop-hints") == 0)
+        options.loop_hints = true;
+    else if (strcmp(arg, "--stdio") == 0)
+        options.stdio = true;
+    else if (strcmp(arg, "--profile") == 0)
+        options.profile = true;
+    else if (strcmp(arg, "--openmp") == 0)
+        options.openmp = true;
+    else if (strcmp(arg, "--no-closed-forms") == 0)
+        options.closed_forms = false;
+    else if (strncmp(arg, "--jobs=", 7) == 0 && option_number(arg + 7) > 0 && option_number(arg + 7) <= jobs_max)
+        options.jobs = option_number(arg + 7);
+    else if (strncmp(arg, "--lanes=", 8) == 0 && lanes_valid(option_number(arg + 8)))
+        options.lanes = option_number(arg + 8);
+    else
+        return false;
+    return true;
+}
 
-            break;
-        case t_div:
-            PREDICT("predict mul_op --> div" << endl);
-            match (t_div, false);
+string options_conflict(const compile_options& options) {
+    if (options.jobs < 1 || options.jobs > jobs_max)
+        return "--jobs=" + to_string(options.jobs) + ": from 1 to " + to_string(jobs_max);
+    if (options.lanes && !lanes_valid(options.lanes))
+        return "--lanes=" + to_string(options.lanes) + ": a power of 2 up to 64";
+    // the lanes have code of their own, none of the options that shape the plain program's
+    if (options.lanes && (options.checked || options.ssa || options.loop_hints || options.stdio || options.profile
+                          || !options.profile_use.empty() || options.openmp || !options.function.empty()))
+        return "--lanes goes with none of --checked, --ssa, --loop-hints, --stdio, --profile, --profile-use, "
+               "--openmp and --batch";
+    return "";
+}
 
-            add_or_create_swap_node(binary_op, t_div);
+void set_statement_hook(statement_hook hook, void* context) {
+    top_level_hook = hook;
+    hook_context = context;
+}
 
-            break;
-        default:
-            //cerr << "Deleting token: " << token_image << endl;
-            throw ExpressionException();
+void parse_program(string_view text, ostream& diag, const compile_options& options, parsed_program& result) {
+    mem_scope scope(mem_parse);
+    scan_reset(text.data(), text.size(), diag);
+    // otherwise the parser scans as it goes, inside the parse span
+    if (options.jobs > 1) {
+        mem_scope tokens(mem_tokens);
+        trace_span span("scan");
+        scan_parallel(options.jobs);
     }
+    parse_scanned(result);
 }
 
-int main () {
+void parse_scanned(parsed_program& result) {
+    mem_scope scope(mem_parse);
+    trace_span span("parse");
+    ast_reset();
+    has_syntax_error = false;
+    semantics = semantic_state();
+
     input_token = scan ();
     program ();
 
-    if (!has_syntax_error) {
-        print_program_ast(pg_sl_root);
-    }
+    result.root = pg_sl_root;
+    result.semantics = semantics;
+    result.syntax_error = has_syntax_error;
+    result.ahead = NULL;
+    mem_phase("parse");
+}
 
-    if (semantic_analysis(pg_sl_root)) {
-        cout << "Pass static semantic check, compile by typing `make compile`!" << endl;
-        compileToC(pg_sl_root);
+bool translate(const parsed_program& program, ostream& ast, ostream& report, ostream& c,
+               const compile_options& options) {
+    // the check was done while parsing; a program that passes has its AST printed by the walk that compiles it
+    ostringstream verdict;
+    bool passed;
+    {
+        trace_span span("semantic check");
+        passed = semantic_analysis(program.semantics, verdict);
     }
-    else {
-        cout << "Fail static semantic check, do not compile!" << endl;
+    bool fused = passed && !program.syntax_error && !program.ahead;
+
+    if (!program.syntax_error && program.ahead) {
+        ast << "(program" << endl << "[ " << program.ahead->ast << "] " << endl << ") ";
+    } else if (!program.syntax_error && !fused) {
+        mem_scope scope(mem_output);
+        trace_span span("print AST");
+        print_program_ast(program.root, ast, options.jobs);
+        mem_phase("printing the AST");
+    }
+
+    if (passed) {
+        mem_scope scope(mem_compile);
+        trace_span span(fused ? "print AST and compile" : "compile");
+        if (fused)
+            ast << "(program" << endl << "[ ";
+        compileToC(program.root, options, c, program.ahead ? &program.ahead->ranges : NULL, fused ? &ast : NULL);
+        if (fused)
+            ast << "] " << endl << ") ";
+        mem_phase(fused ? "printing the AST and compiling" : "compiling");
     }
+    report << verdict.str();
+    if (passed)
+        report << "Pass static semantic check, compile by typing `make compile`!" << endl;
+    else
+        report << "Fail static semantic check, do not compile!" << endl;
+    return passed;
+}
 
-    return 0;
+bool translate(string_view text, ostream& ast, ostream& report, ostream& diag, ostream& c,
+               const compile_options& options) {
+    string conflict = options_conflict(options);
+    if (!conflict.empty()) {
+        diag << conflict << endl;
+        return false;
+    }
+    parsed_program program;
+    parse_program(text, diag, options, program);
+    return translate(program, ast, report, c, options);
 }
@@ -0,0 +1,61 @@
+#ifndef __PARSE_H
+#define __PARSE_H
+
+#include <iostream>
+#include <string_view>
+#include "compile.h"
+#include "range.h"
+#include "semantic.h"
+
+// sets the flag arg names (--checked, --ssa, ...), false if there is no such flag
+bool parse_option(const char* arg, compile_options& options);
+
+// why the options are out of range or do not go together, empty if they are fine;
+// what translate refuses, also options set without parse_option (libcalc)
+std::string options_conflict(const compile_options& options);
+
+// what the pipelined front end (pipeline.h) did with the statements while they were parsed
+struct parsed_ahead {
+    std::string ast;        // the statements as print_program_ast prints them
+    range_info ranges;      // analyze_ranges of the program
+};
+
+// what the front end hands on: the AST lives in the parsing thread's arena
+// (ast_alloc) until that thread parses or loads the next program
+struct parsed_program {
+    st_list* root;
+    semantic_state semantics;
+    bool syntax_error;      // the AST is not printed, errors went to diag
+    const parsed_ahead* ahead = NULL;   // translate uses it instead of doing it again
+};
+
+// scanner and parser alone
+void parse_program(std::string_view text, std::ostream& diag, const compile_options& options,
+                   parsed_program& result);
+
+// the parser alone, on the tokens scan() hands out once the scanner is set up
+void parse_scanned(parsed_program& result);
+
+/*
+ * with a hook set, the parsing thread calls it with every top-level statement
+ * the parser is done with, and with NULL whenever it starts the program
+ * (again, error recovery drops the statements before)
+ */
+typedef void (*statement_hook)(st* statement, void* context);
+void set_statement_hook(statement_hook hook, void* context);
+
+// everything after the parser: AST, semantic report and C, as below
+bool translate(const parsed_program& program, std::ostream& ast, std::ostream& report, std::ostream& c,
+               const compile_options& options);
+
+/*
+ * the whole pipeline on one program: the AST goes to ast, the semantic report
+ * to report, syntax errors to diag, and the C program to c if the program
+ * passes the semantic check (the return value); all state is per thread and
+ * reset on entry, so several threads can translate at once. Options that
+ * conflict (options_conflict) are refused on diag before anything is read.
+ */
+bool translate(std::string_view text, std::ostream& ast, std::ostream& report, std::ostream& diag,
+               std::ostream& c, const compile_options& options);
+
+#endif
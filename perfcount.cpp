@@ -0,0 +1,90 @@
+#include "perfcount.h"
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+const char* const perf_counter_names[perf_counters] = {
+    "cycles", "instructions", "L1d misses", "LLC misses", "branch misses", "task ns", "page faults"
+};
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} events[perf_counters] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                         | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+};
+
+static double seconds() {
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+perf_collector::perf_collector() : started(0) {
+    for (int i = 0; i < perf_counters; i++) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof attr);
+        attr.size = sizeof attr;
+        attr.type = events[i].type;
+        attr.config = events[i].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        fd[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fd[i] >= 0 || !reason.empty())
+            continue;
+        reason = string(perf_counter_names[i]) + ": " + strerror(errno);
+        if (errno == ENOENT || errno == EOPNOTSUPP)
+            reason += " (no such counter on this machine, a VM or container without a PMU?)";
+        ifstream paranoid("/proc/sys/kernel/perf_event_paranoid");
+        int level;
+        if ((errno == EACCES || errno == EPERM) && paranoid >> level)
+            reason += " (kernel.perf_event_paranoid is " + to_string(level) + ")";
+    }
+}
+
+perf_collector::~perf_collector() {
+    for (int i = 0; i < perf_counters; i++)
+        if (fd[i] >= 0)
+            close(fd[i]);
+}
+
+void perf_collector::start() {
+    for (int i = 0; i < perf_counters; i++) {
+        if (fd[i] < 0)
+            continue;
+        ioctl(fd[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+    started = seconds();
+}
+
+perf_sample perf_collector::stop() {
+    perf_sample sample;
+    sample.wall = seconds() - started;
+    for (int i = 0; i < perf_counters; i++) {
+        sample.value[i] = -1;
+        if (fd[i] < 0)
+            continue;
+        ioctl(fd[i], PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t read_values[3];        // value, time enabled, time running
+        if (read(fd[i], read_values, sizeof read_values) != sizeof read_values || read_values[2] == 0)
+            continue;
+        sample.value[i] = (double) read_values[0] * read_values[1] / read_values[2];
+    }
+    return sample;
+}
@@ -0,0 +1,51 @@
+#ifndef __PERFCOUNT_H
+#define __PERFCOUNT_H
+
+#include <string>
+
+/*
+ * hardware counters of the calling thread for the benchmarks (perf_event_open)
+ *
+ * Cycles, instructions, L1 data cache read misses, last level cache misses
+ * and branch misses, user space only, plus the task clock and page faults
+ * the kernel counts in software. Each counter is opened on its own, so one
+ * the machine does not have leaves the others: in a container or a virtual
+ * machine without a PMU the hardware ones fail, the software ones usually
+ * stay, and with perf_event_open refused altogether only the wall clock is
+ * left. unavailable() says why for the report.
+ *
+ * When the kernel multiplexes the counters a value is scaled up by the time
+ * it was enabled over the time it ran.
+ */
+enum perf_counter {
+    perf_cycles, perf_instructions, perf_l1d_misses, perf_llc_misses, perf_branch_misses,
+    perf_task_clock, perf_page_faults,
+    perf_counters
+};
+
+extern const char* const perf_counter_names[perf_counters];
+
+struct perf_sample {
+    double wall;                        // seconds
+    double value[perf_counters];        // -1: not counted
+};
+
+class perf_collector {
+public:
+    perf_collector();
+    ~perf_collector();
+
+    bool counting(perf_counter which) const { return fd[which] >= 0; }
+    // the first reason a counter could not be opened, empty when all were
+    const std::string& unavailable() const { return reason; }
+
+    void start();
+    perf_sample stop();
+
+private:
+    int fd[perf_counters];
+    std::string reason;
+    double started;
+};
+
+#endif
@@ -0,0 +1,161 @@
+#include "pipeline.h"
+#include "ast.h"
+#include "memstat.h"
+#include "pool.h"
+#include "range.h"
+#include "scan.h"
+#include "trace.h"
+#include <algorithm>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static const size_t block_size = 64 * 1024;
+static const size_t batch_tokens = 4096;
+
+// marks the end of the program on the ring of statements, NULL starts it over
+static st end_of_program;
+
+struct pipeline {
+    spsc_ring<vector<char>, 8> blocks;          // an empty block ends the text
+    spsc_ring<token_chunk, 8> batches;          // the last batch ends in eof
+    spsc_ring<st*, 1024> statements;
+
+    vector<char> block;                         // the scanner's current one
+    bool text_ended;
+    bool tokens_ended;                          // the parser has had the last batch
+};
+
+static void read_blocks(FILE* in, pipeline& p, size_t& lines) {
+    trace_thread("reader");
+    lines = 0;
+    for (;;) {
+        vector<char> block(block_size);
+        size_t n;
+        {
+            trace_span span("read block");
+            n = fread(block.data(), 1, block_size, in);
+        }
+        block.resize(n);
+        lines += count(block.begin(), block.end(), '\n');
+        p.blocks.push(move(block));
+        if (n == 0)
+            return;
+    }
+}
+
+static bool next_block(const char** text, size_t* size, void* context) {
+    pipeline& p = *(pipeline*) context;
+    if (p.text_ended)
+        return false;
+    p.blocks.pop(p.block);
+    p.text_ended = p.block.empty();
+    *text = p.block.data();
+    *size = p.block.size();
+    return !p.text_ended;
+}
+
+static void scan_batches(pipeline& p) {
+    mem_scope scope(mem_tokens);
+    trace_thread("scanner");
+    p.text_ended = false;
+    scan_source(next_block, &p);
+    for (;;) {
+        token_chunk batch;
+        bool ended;
+        {
+            trace_span span("scan batch");
+            ended = scan_batch(batch, batch_tokens);
+        }
+        p.batches.push(move(batch));
+        if (ended)
+            return;
+    }
+}
+
+static void next_batch(token_chunk& batch, void* context) {
+    pipeline& p = *(pipeline*) context;
+    p.batches.pop(batch);
+    p.tokens_ended = !batch.tokens.empty() && batch.tokens.back().type == t_eof;
+}
+
+static void statement_done(st* statement, void* context) {
+    ((pipeline*) context)->statements.push(move(statement));
+}
+
+// the statements of the program as the emitter saw them, in order
+static void emit_statements(pipeline& p, parsed_ahead& ahead, vector<st*>& seen) {
+    // nothing is printed from a program with syntax errors, the only kind with statements of no type
+    ostringstream discarded;
+    diag_out = &discarded;
+    trace_thread("emitter");
+    output_buffer text;
+    unique_ptr<range_walk> walk(new range_walk(ahead.ranges));
+
+    for (;;) {
+        st* statement;
+        p.statements.pop(statement);
+        if (statement == &end_of_program)
+            break;
+        if (!statement) {
+            text.str("");
+            seen.clear();
+            walk.reset();
+            ahead.ranges = range_info();
+            walk.reset(new range_walk(ahead.ranges));
+            continue;
+        }
+        trace_span span("emit statement", statement->line);
+        {
+            mem_scope scope(mem_output);
+            print_stmt(statement, text);
+        }
+        mem_scope scope(mem_compile);
+        walk->statement(statement);
+        seen.push_back(statement);
+    }
+    {
+        mem_scope scope(mem_compile);
+        walk->finish();
+    }
+    mem_scope scope(mem_output);
+    ahead.ast = text.str();
+}
+
+void parse_pipelined(FILE* in, ostream& diag, parsed_program& result, parsed_ahead& ahead, size_t& lines) {
+    unique_ptr<pipeline> p(new pipeline);
+    vector<st*> seen;
+
+    thread reader(read_blocks, in, ref(*p), ref(lines));
+    thread scanner(scan_batches, ref(*p));
+    thread emitter(emit_statements, ref(*p), ref(ahead), ref(seen));
+
+    p->tokens_ended = false;
+    scan_stream(next_batch, p.get(), diag);
+    set_statement_hook(statement_done, p.get());
+    parse_scanned(result);
+    set_statement_hook(NULL, NULL);
+    p->statements.push(&end_of_program);
+    // error recovery may give up before the end, the scanner must not wait on a full ring
+    for (token_chunk rest; !p->tokens_ended; )
+        next_batch(rest, p.get());
+
+    reader.join();
+    scanner.join();
+    emitter.join();
+
+    // the emitter has seen every statement of the program, or translate does it all again
+    size_t i = 0;
+    for (st_list* sl = result.root; sl != NULL; sl = sl->r_child) {
+        if (!sl->l_child)
+            continue;
+        if (i == seen.size() || seen[i] != sl->l_child)
+            return;
+        i++;
+    }
+    if (i == seen.size())
+        result.ahead = &ahead;
+}
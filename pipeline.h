@@ -0,0 +1,27 @@
+#ifndef __PIPELINE_H
+#define __PIPELINE_H
+
+#include <cstdio>
+#include <iostream>
+#include "parse.h"
+
+/*
+ * pipelined front end (parse --pipeline): one program on four threads
+ *
+ *   reader    fills blocks of text from the file
+ *   scanner   cuts them into batches of tokens
+ *   parser    the calling thread, builds the AST from the tokens
+ *   emitter   prints every top-level statement the parser is done with and
+ *             runs the range analysis over it (range_walk)
+ *
+ * each stage hands on to the next through an spsc_ring (pool.h), waiting
+ * while the ring after it is full or the one before it empty, so only a
+ * few blocks, batches and statements are ever in flight. The C itself is
+ * written by translate afterwards, the types it declares come from the
+ * whole program; with what the emitter did in result.ahead translate only
+ * has that left. Everything comes out as parse_program and translate give
+ * it for the whole text, lines is the number of newlines read
+ */
+void parse_pipelined(FILE* in, std::ostream& diag, parsed_program& result, parsed_ahead& ahead, size_t& lines);
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef __POOL_H
+#define __POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * fixed set of threads taking jobs (accepted connections) off a queue;
+ * a thread keeps its compilation state (see translate) between jobs
+ */
+class worker_pool {
+public:
+    worker_pool(int n, void (*work)(int)) : work(work), stopping(false) {
+        for (int i = 0; i < n; i++)
+            threads.push_back(std::thread(&worker_pool::run, this));
+    }
+
+    // finishes the queued jobs first
+    ~worker_pool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        ready.notify_all();
+        for (size_t i = 0; i < threads.size(); i++)
+            threads[i].join();
+    }
+
+    void submit(int job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(job);
+        }
+        ready.notify_one();
+    }
+
+private:
+    void run() {
+        for (;;) {
+            int job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                while (!stopping && jobs.empty())
+                    ready.wait(lock);
+                if (jobs.empty())
+                    return;
+                job = jobs.front();
+                jobs.pop_front();
+            }
+            work(job);
+        }
+    }
+
+    void (*work)(int);
+    bool stopping;
+    std::deque<int> jobs;
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::vector<std::thread> threads;
+};
+
+/*
+ * work(i) for every i in [0, n) on up to `threads` new threads, returns when
+ * all are done; the threads start with fresh thread_local state
+ */
+template <class F>
+void parallel_for(int n, int threads, F work) {
+    std::atomic<int> next(0);
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads && t < n; t++) {
+        pool.push_back(std::thread([&]() {
+            for (int i = next++; i < n; i = next++)
+                work(i);
+        }));
+    }
+    for (size_t t = 0; t < pool.size(); t++)
+        pool[t].join();
+}
+
+/*
+ * bounded lock-free queue between one producing and one consuming thread
+ * (the stages of pipeline.h): head and tail only ever grow, each is written
+ * by one side alone and sit on cache lines of their own. A full ring makes
+ * push wait, an empty one pop, by giving up the processor until the other
+ * side moves; capacity is a power of 2
+ */
+template <class T, size_t capacity>
+class spsc_ring {
+public:
+    spsc_ring() : head(0), tail(0) {
+        static_assert((capacity & (capacity - 1)) == 0, "capacity is a power of 2");
+    }
+
+    void push(T&& item) {
+        size_t at = tail.load(std::memory_order_relaxed);
+        while (at - head.load(std::memory_order_acquire) == capacity)
+            std::this_thread::yield();
+        slots[at & (capacity - 1)] = std::move(item);
+        tail.store(at + 1, std::memory_order_release);
+    }
+
+    void pop(T& item) {
+        size_t at = head.load(std::memory_order_relaxed);
+        while (tail.load(std::memory_order_acquire) == at)
+            std::this_thread::yield();
+        item = std::move(slots[at & (capacity - 1)]);
+        head.store(at + 1, std::memory_order_release);
+    }
+
+private:
+    alignas(64) std::atomic<size_t> head;       // next to pop, the consumer's
+    alignas(64) std::atomic<size_t> tail;       // next to fill, the producer's
+    alignas(64) T slots[capacity];
+};
+
+#endif
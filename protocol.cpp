@@ -0,0 +1,55 @@
+#include "protocol.h"
+#include <sstream>
+#include <cerrno>
+#include <unistd.h>
+
+using namespace std;
+
+bool read_all(int fd, string& data) {
+    char buffer[1 << 16];
+    for (;;) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n == 0)
+            return true;
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data.append(buffer, n);
+    }
+}
+
+bool write_all(int fd, const char* data, size_t n) {
+    while (n > 0) {
+        ssize_t written = write(fd, data, n);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += written;
+        n -= written;
+    }
+    return true;
+}
+
+bool read_section(const string& reply, size_t& pos, string& name, string& body) {
+    size_t eol = reply.find('\n', pos);
+    if (eol == string::npos)
+        return false;
+    istringstream header(reply.substr(pos, eol - pos));
+    size_t length;
+    if (!(header >> name >> length) || eol + 1 + length > reply.size())
+        return false;
+    body = reply.substr(eol + 1, length);
+    pos = eol + 1 + length;
+    return true;
+}
+
+void add_section(string& reply, const char* name, const string& body) {
+    ostringstream header;
+    header << name << " " << body.size() << "\n";
+    reply += header.str();
+    reply += body;
+}
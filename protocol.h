@@ -0,0 +1,25 @@
+#ifndef __PROTOCOL_H
+#define __PROTOCOL_H
+
+#include <string>
+
+/*
+ * one request per connection to `parse --serve`
+ *
+ * request: one line of parse flags (may be empty), then the program text up
+ *          to the end of the stream (the client shuts down its write side)
+ * reply:   three sections, each "<name> <length>\n" and <length> bytes
+ *          out   the AST and the semantic report, what parse prints on stdout
+ *          diag  syntax errors, what parse prints on stderr
+ *          c     the C program, empty if the semantic check failed
+ */
+
+// until the peer shuts down its side
+bool read_all(int fd, std::string& data);
+bool write_all(int fd, const char* data, size_t n);
+
+void add_section(std::string& reply, const char* name, const std::string& body);
+// the section starting at pos, false if the reply is cut short
+bool read_section(const std::string& reply, size_t& pos, std::string& name, std::string& body);
+
+#endif
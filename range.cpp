@@ -0,0 +1,527 @@
+#include "range.h"
+#include <set>
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+
+using namespace std;
+
+/*
+ * abstract interpretation of the program over intervals
+ *
+ * - a read gives what the variable's type holds, joined with what it held
+ *   (a read at the end of the input changes nothing): int, or every int64_t
+ *   when the rest of the program makes the variable int64_t; that is known
+ *   only once the whole program is analyzed, so the analysis runs again
+ *   until no read turns out wider than it was taken to be
+ * - literals are exact
+ * - `if R` and `check R` narrow the compared variables on each outgoing path
+ * - a do loop is iterated to a fixpoint, bounds that keep growing are widened
+ *   to the next int8, int16, int32 or unbounded limit, then one narrowing pass
+ *   takes back what the loop checks prove
+ * - only the last pass over a loop body records into range_info, so the widened
+ *   intermediate states never leak into the declared types
+ */
+
+// variables are numbered in the order the analysis meets them, an env is
+// indexed by that number so copying one at every join is a flat copy
+struct env {
+    bool reachable;
+    vector<range> vars;         // by slot, empty interval (or past the end): not assigned on any path yet
+};
+
+struct analyzer {
+    range_info* info;
+    bool record;
+    vector<vector<env>*> loop_exits;    // innermost do on top
+    map<string, int, less<> > slots;
+    set<string, less<> > wide;          // variables declared int64_t, read as such
+};
+
+static const range int_range = {INT_MIN, INT_MAX};
+static const range int64_range = {RANGE_MIN, RANGE_MAX};
+static const range bool_range = {0, 1};
+static const range unassigned = {RANGE_MAX, RANGE_MIN};
+
+static const long long upper_thresholds[] = {127, 32767, INT_MAX, RANGE_MAX};
+static const long long lower_thresholds[] = {-128, -32768, INT_MIN, RANGE_MIN};
+static const int n_thresholds = sizeof(upper_thresholds) / sizeof(long long);
+
+// plain joins before widening starts, lets short loops settle exactly
+static const int widen_delay = 2;
+
+static void exec_list(analyzer& a, st_list* sl, env& e);
+
+bool range_fits(range r, long long lo, long long hi) {
+    return r.lo >= lo && r.hi <= hi;
+}
+
+bool range_bounded(range r) {
+    return r.lo != RANGE_MIN && r.hi != RANGE_MAX;
+}
+
+const char* range_c_type(range r) {
+    if (range_fits(r, -128, 127))
+        return "int8_t";
+    else if (range_fits(r, -32768, 32767))
+        return "int16_t";
+    else if (range_fits(r, INT_MIN, INT_MAX))
+        return "int";
+    else
+        return "int64_t";
+}
+
+/*
+ * interval arithmetic, RANGE_MIN and RANGE_MAX behave as -inf and +inf
+ */
+static long long saturate(__int128 v) {
+    if (v <= RANGE_MIN)
+        return RANGE_MIN;
+    if (v >= RANGE_MAX)
+        return RANGE_MAX;
+    return (long long) v;
+}
+
+static bool infinite(long long v) {
+    return v == RANGE_MIN || v == RANGE_MAX;
+}
+
+static int sign(long long v) {
+    return (v > 0) - (v < 0);
+}
+
+static long long mul_bound(long long x, long long y) {
+    if (x == 0 || y == 0)
+        return 0;
+    if (infinite(x) || infinite(y))
+        return sign(x) * sign(y) > 0 ? RANGE_MAX : RANGE_MIN;
+    return saturate((__int128) x * y);
+}
+
+// y is never 0, the caller splits the divisor around it
+static long long div_bound(long long x, long long y) {
+    if (infinite(x))
+        return sign(x) * sign(y) > 0 ? RANGE_MAX : RANGE_MIN;
+    if (infinite(y))
+        return 0;
+    return saturate((__int128) x / y);
+}
+
+static range corners(long long (*f)(long long, long long), range l, range r) {
+    long long c[] = {f(l.lo, r.lo), f(l.lo, r.hi), f(l.hi, r.lo), f(l.hi, r.hi)};
+    range res = {*min_element(c, c + 4), *max_element(c, c + 4)};
+    return res;
+}
+
+static range join(range a, range b) {
+    range res = {min(a.lo, b.lo), max(a.hi, b.hi)};
+    return res;
+}
+
+static bool contains(range outer, range inner) {
+    return outer.lo <= inner.lo && inner.hi <= outer.hi;
+}
+
+static range arith(token op, range l, range r) {
+    range res;
+    switch (op) {
+        case t_add:
+            res.lo = (l.lo == RANGE_MIN || r.lo == RANGE_MIN) ? RANGE_MIN : saturate((__int128) l.lo + r.lo);
+            res.hi = (l.hi == RANGE_MAX || r.hi == RANGE_MAX) ? RANGE_MAX : saturate((__int128) l.hi + r.hi);
+            return res;
+        case t_sub:
+            res.lo = (l.lo == RANGE_MIN || r.hi == RANGE_MAX) ? RANGE_MIN : saturate((__int128) l.lo - r.hi);
+            res.hi = (l.hi == RANGE_MAX || r.lo == RANGE_MIN) ? RANGE_MAX : saturate((__int128) l.hi - r.lo);
+            return res;
+        case t_mul:
+            return corners(mul_bound, l, r);
+        case t_div: {
+            // x / 0 traps at run time, only the nonzero parts of the divisor matter
+            bool any = false;
+            if (r.lo < 0) {
+                range neg = {r.lo, min(r.hi, -1LL)};
+                res = corners(div_bound, l, neg);
+                any = true;
+            }
+            if (r.hi > 0) {
+                range pos = {max(r.lo, 1LL), r.hi};
+                range q = corners(div_bound, l, pos);
+                res = any ? join(res, q) : q;
+                any = true;
+            }
+            if (!any)
+                res = int_range;
+            return res;
+        }
+        default:
+            return int_range;
+    }
+}
+
+static bool is_relation(token t) {
+    return t == t_eq || t == t_noteq || t == t_lt || t == t_gt || t == t_lte || t == t_gte;
+}
+
+/*
+ * environments
+ */
+static int slot(analyzer& a, const char* name) {
+    map<string, int, less<> >::iterator found = a.slots.find(name);
+    if (found != a.slots.end())
+        return found->second;
+    int n = a.slots.size();
+    a.slots[name] = n;
+    return n;
+}
+
+static bool assigned(range r) {
+    return r.lo <= r.hi;
+}
+
+static range get_var(const env& e, int slot) {
+    return slot < (int) e.vars.size() ? e.vars[slot] : unassigned;
+}
+
+static void set_var(env& e, int slot, range r) {
+    if (slot >= (int) e.vars.size())
+        e.vars.resize(slot + 1, unassigned);
+    e.vars[slot] = r;
+}
+
+// the unassigned interval is empty, so it is the identity of join
+static env join(const env& a, const env& b) {
+    if (!a.reachable)
+        return b;
+    if (!b.reachable)
+        return a;
+    env res = a.vars.size() >= b.vars.size() ? a : b;
+    const env& other = a.vars.size() >= b.vars.size() ? b : a;
+    for (size_t i = 0; i < other.vars.size(); i++)
+        res.vars[i] = join(res.vars[i], other.vars[i]);
+    return res;
+}
+
+static bool leq(const env& a, const env& b) {
+    if (!a.reachable)
+        return true;
+    if (!b.reachable)
+        return false;
+    for (size_t i = 0; i < a.vars.size(); i++) {
+        range r = get_var(b, i);
+        if (assigned(a.vars[i]) && (!assigned(r) || !contains(r, a.vars[i])))
+            return false;
+    }
+    return true;
+}
+
+static long long widen_up(long long v) {
+    for (int i = 0; i < n_thresholds; i++)
+        if (upper_thresholds[i] >= v)
+            return upper_thresholds[i];
+    return RANGE_MAX;
+}
+
+static long long widen_down(long long v) {
+    for (int i = 0; i < n_thresholds; i++)
+        if (lower_thresholds[i] <= v)
+            return lower_thresholds[i];
+    return RANGE_MIN;
+}
+
+static env widen(const env& old, const env& next) {
+    env res = join(old, next);
+    if (!old.reachable)
+        return res;
+    for (size_t i = 0; i < res.vars.size(); i++) {
+        range prev = get_var(old, i);
+        if (!assigned(prev))
+            continue;
+        if (res.vars[i].lo < prev.lo)
+            res.vars[i].lo = widen_down(res.vars[i].lo);
+        if (res.vars[i].hi > prev.hi)
+            res.vars[i].hi = widen_up(res.vars[i].hi);
+    }
+    return res;
+}
+
+/*
+ * expressions
+ */
+static void record_var(analyzer& a, const char* name, range r) {
+    if (!a.record)
+        return;
+    map<string, range>::iterator found = a.info->variables.find(name);
+    if (found == a.info->variables.end())
+        a.info->variables[name] = r;
+    else
+        found->second = join(found->second, r);
+}
+
+static range lookup(analyzer& a, const env& e, const char* name) {
+    range r = get_var(e, slot(a, name));
+    if (assigned(r))
+        return r;
+    // used before any assignment, holds whatever int was on the stack
+    record_var(a, name, int_range);
+    return int_range;
+}
+
+static range eval(analyzer& a, bin_op* node, const env& e) {
+    range res;
+
+    if (node->type == t_literal) {
+        res.lo = res.hi = strtoll(node->name, NULL, 10);
+    } else if (node->type == t_id) {
+        res = lookup(a, e, node->name);
+    } else if (node->l_child && node->r_child) {
+        range l = eval(a, node->l_child, e);
+        range r = eval(a, node->r_child, e);
+        res = is_relation(node->type) ? bool_range : arith(node->type, l, r);
+    } else {
+        // placeholder left behind by error recovery
+        res = int_range;
+    }
+
+    if (a.record) {
+        map<const bin_op*, range>::iterator found = a.info->nodes.find(node);
+        if (found == a.info->nodes.end())
+            a.info->nodes[node] = res;
+        else
+            found->second = join(found->second, res);
+    }
+    return res;
+}
+
+static token negate_relation(token op) {
+    switch (op) {
+        case t_eq: return t_noteq;
+        case t_noteq: return t_eq;
+        case t_lt: return t_gte;
+        case t_gte: return t_lt;
+        case t_gt: return t_lte;
+        case t_lte: return t_gt;
+        default: return op;
+    }
+}
+
+// a op b  <=>  b mirror_relation(op) a
+static token mirror_relation(token op) {
+    switch (op) {
+        case t_lt: return t_gt;
+        case t_gt: return t_lt;
+        case t_lte: return t_gte;
+        case t_gte: return t_lte;
+        default: return op;
+    }
+}
+
+// narrow variable `name` so that `name op other` holds
+static void narrow(analyzer& a, env& e, const char* name, token op, range other) {
+    range v = lookup(a, e, name);
+
+    switch (op) {
+        case t_lt:
+            if (other.hi != RANGE_MAX && other.hi != RANGE_MIN)
+                v.hi = min(v.hi, other.hi - 1);
+            break;
+        case t_lte:
+            v.hi = min(v.hi, other.hi);
+            break;
+        case t_gt:
+            if (other.lo != RANGE_MIN && other.lo != RANGE_MAX)
+                v.lo = max(v.lo, other.lo + 1);
+            break;
+        case t_gte:
+            v.lo = max(v.lo, other.lo);
+            break;
+        case t_eq:
+            v.lo = max(v.lo, other.lo);
+            v.hi = min(v.hi, other.hi);
+            break;
+        case t_noteq:
+            if (other.lo == other.hi && v.lo == other.lo && v.lo != RANGE_MAX)
+                v.lo++;
+            else if (other.lo == other.hi && v.hi == other.hi && v.hi != RANGE_MIN)
+                v.hi--;
+            break;
+        default:
+            break;
+    }
+
+    if (v.lo > v.hi)
+        e.reachable = false;
+    else
+        set_var(e, slot(a, name), v);
+}
+
+// narrow e to the states in which `cond` evaluates to truth
+static void refine(analyzer& a, bin_op* cond, bool truth, env& e) {
+    if (!e.reachable)
+        return;
+
+    bool record = a.record;
+    a.record = false;
+
+    if (is_relation(cond->type) && cond->l_child && cond->r_child) {
+        token op = truth ? cond->type : negate_relation(cond->type);
+        bin_op* l = cond->l_child;
+        bin_op* r = cond->r_child;
+        if (l->type == t_id)
+            narrow(a, e, l->name, op, eval(a, r, e));
+        if (r->type == t_id && e.reachable)
+            narrow(a, e, r->name, mirror_relation(op), eval(a, l, e));
+    } else if (cond->type == t_id) {
+        range zero = {0, 0};
+        narrow(a, e, cond->name, truth ? t_noteq : t_eq, zero);
+    }
+
+    a.record = record;
+}
+
+/*
+ * statements
+ */
+static void exec_loop(analyzer& a, st_list* body, env& e) {
+    bool record = a.record;
+    vector<env> exits;
+    env head = e;
+    env back;
+
+    a.record = false;
+    a.loop_exits.push_back(&exits);
+
+    for (int iter = 0; ; iter++) {
+        exits.clear();
+        back = head;
+        exec_list(a, body, back);
+        env next = join(e, back);
+        if (leq(next, head))
+            break;
+        head = iter < widen_delay ? join(head, next) : widen(head, next);
+    }
+
+    // narrowing, head is a post fixpoint so one more pass stays sound
+    back = head;
+    exec_list(a, body, back);
+    head = join(e, back);
+
+    // recording pass
+    a.record = record;
+    exits.clear();
+    back = head;
+    exec_list(a, body, back);
+    a.loop_exits.pop_back();
+
+    env out;
+    out.reachable = false;
+    for (size_t i = 0; i < exits.size(); i++)
+        out = join(out, exits[i]);
+    e = out;
+}
+
+static void exec_stmt(analyzer& a, st* s, env& e) {
+    range r;
+    env taken;
+
+    if (!e.reachable)
+        return;
+
+    switch (s->type) {
+        case t_id:
+            r = eval(a, s->rel, e);
+            set_var(e, slot(a, s->id), r);
+            record_var(a, s->id, r);
+            break;
+        case t_read:
+            r = join(lookup(a, e, s->id), a.wide.count(s->id) ? int64_range : int_range);
+            set_var(e, slot(a, s->id), r);
+            record_var(a, s->id, r);
+            break;
+        case t_write:
+            eval(a, s->rel, e);
+            break;
+        case t_if:
+            eval(a, s->rel, e);
+            taken = e;
+            refine(a, s->rel, true, taken);
+            exec_list(a, s->sl, taken);
+            refine(a, s->rel, false, e);
+            e = join(e, taken);
+            break;
+        case t_do:
+            exec_loop(a, s->sl, e);
+            break;
+        case t_check:
+            eval(a, s->rel, e);
+            if (!a.loop_exits.empty()) {
+                env exit = e;
+                refine(a, s->rel, false, exit);
+                if (exit.reachable)
+                    a.loop_exits.back()->push_back(exit);
+            }
+            refine(a, s->rel, true, e);
+            break;
+        default:
+            break;
+    }
+}
+
+static void exec_list(analyzer& a, st_list* sl, env& e) {
+    for (; sl != NULL; sl = sl->r_child) {
+        if (sl->l_child)
+            exec_stmt(a, sl->l_child, e);
+    }
+}
+
+// true when the last run made variables int64_t whose reads it took as int; they are read as int64_t from now on
+static bool widen_reads(analyzer& a) {
+    bool grown = false;
+    for (map<string, range>::const_iterator it = a.info->variables.begin(); it != a.info->variables.end(); it++)
+        if (!range_fits(it->second, INT_MIN, INT_MAX) && a.wide.insert(it->first).second)
+            grown = true;
+    return grown;
+}
+
+void analyze_ranges(st_list* root, range_info& info) {
+    analyzer a;
+    a.info = &info;
+    a.record = true;
+
+    do {
+        info = range_info();
+        env e;
+        e.reachable = true;
+        exec_list(a, root, e);
+    } while (widen_reads(a));
+}
+
+struct range_walk::state {
+    analyzer a;
+    env e;
+    vector<st*> statements;     // for the runs again of finish
+};
+
+range_walk::range_walk(range_info& info) : walk(new state) {
+    walk->a.info = &info;
+    walk->a.record = true;
+    walk->e.reachable = true;
+}
+
+range_walk::~range_walk() {
+    delete walk;
+}
+
+void range_walk::statement(st* s) {
+    walk->statements.push_back(s);
+    exec_stmt(walk->a, s, walk->e);
+}
+
+void range_walk::finish() {
+    while (widen_reads(walk->a)) {
+        *walk->a.info = range_info();
+        walk->e = env();
+        walk->e.reachable = true;
+        for (size_t i = 0; i < walk->statements.size(); i++)
+            exec_stmt(walk->a, walk->statements[i], walk->e);
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef __RANGE_H
+#define __RANGE_H
+
+#include <climits>
+#include <map>
+#include <string>
+#include "ast.h"
+
+/*
+ * closed interval [lo, hi] of the values a variable or an expression can take,
+ * RANGE_MIN and RANGE_MAX mark an end that could not be bounded
+ */
+const long long RANGE_MIN = LLONG_MIN;
+const long long RANGE_MAX = LLONG_MAX;
+
+struct range {
+    long long lo;
+    long long hi;
+};
+
+/*
+ * result of the analysis, every value is the join over all program points
+ * - variables: everything the variable is ever assigned (or read by `read`)
+ * - nodes:     everything an expression node ever evaluates to
+ */
+struct range_info {
+    std::map<std::string, range> variables;
+    std::map<const bin_op*, range> nodes;
+};
+
+void analyze_ranges(st_list* root, range_info& info);
+
+/*
+ * the same analysis one top-level statement at a time, for a front end that
+ * hands them over as they are parsed (pipeline.h): nothing flows back to a
+ * top-level statement from the ones after it but the types of the variables
+ * they read, so after the last one and finish info is what analyze_ranges
+ * gives for the list of them
+ */
+class range_walk {
+public:
+    explicit range_walk(range_info& info);
+    ~range_walk();
+    void statement(st* s);
+    // runs the statements again while reads turn out int64_t (see range.cpp)
+    void finish();
+private:
+    struct state;
+    state* walk;
+};
+
+bool range_fits(range r, long long lo, long long hi);
+bool range_bounded(range r);
+const char* range_c_type(range r);
+
+#endif
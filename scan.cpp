@@ -6,18 +6,82 @@
 #include <cstdlib>
 #include <cstring>
 #include <cctype>
+#include <cstdint>
 #include <stdio.h>
+#include <sstream>
+#include <algorithm>
 
 #include "scan.h"
+#include "pool.h"
+#include "memstat.h"
+#include "trace.h"
 
 using namespace std;
 
-char token_image[100];
+// the text scan_text reads a token into; token_image points here, or into a chunk's images while replaying
+static thread_local char token_text[token_max + 1];
+thread_local const char* token_image = "";
 
-int lineno = 1;
+thread_local int lineno = 1;
+thread_local int token_line = 1;
+
+thread_local ostream* diag_out = &cerr;
+
+static thread_local const char* scan_pos;
+static thread_local const char* scan_end;
+static thread_local bool scan_eof;
+static thread_local text_source more_text;     // NULL: the text given to scan_reset is all there is
+static thread_local void* text_context;
+
+/* next available char; extra (int) width accommodates EOF */
+static thread_local int c = ' ';
+
+// tokens scanned ahead by scan_parallel, handed out by scan() while replaying
+static thread_local vector<token_chunk> chunks;
+static thread_local bool replaying;
+static thread_local size_t replay_chunk, replay_token;
+static thread_local batch_source more_tokens;  // NULL: chunks holds every token
+static thread_local void* tokens_context;
+
+// a chunk is at least this big, smaller inputs are not worth the threads
+static const size_t min_chunk = 64 * 1024;
+
+// token_image of the tokens that can only be spelled one way, by token
+static const char* const fixed_images[] = {
+    "read", "write", NULL, NULL, ":=",
+    "+", "-", "*", "/", "(", ")", NULL,
+    "if", "fi", "do", "od", "check",
+    "==", "<>", "<", ">", "<=", ">=", NULL
+};
+
+void scan_reset(const char* text, size_t size, ostream& diag) {
+    scan_pos = text;
+    scan_end = text + size;
+    scan_eof = false;
+    diag_out = &diag;
+    lineno = 1;
+    token_line = 1;
+    c = ' ';
+    replaying = false;
+    // the chunks token_image may point into are about to go
+    if (token_image != token_text) {
+        strcpy(token_text, token_image);
+        token_image = token_text;
+    }
+    more_text = NULL;
+    more_tokens = NULL;
+}
 
 char lineno_get() {
-    char c = cin.get();
+    while (scan_pos == scan_end) {
+        size_t size;
+        if (!more_text || !more_text(&scan_pos, &size, text_context)) {
+            scan_eof = true;
+            return EOF;
+        }
+        scan_end = scan_pos + size;
+    }
+    char c = *scan_pos++;
     if (c == '\n') {
         lineno++;
 //        DEBUG(endl << "add line" << endl);
@@ -25,151 +89,323 @@ char lineno_get() {
     return c;
 }
 
-token scan() {
-    static int c = ' ';
-    /* next available char; extra (int) width accommodates EOF */
-    int i = 0;              /* index into token_image */
+// an id or literal of length characters, token_text holds the first token_max of them
+static token too_long(int length) {
+    token_text[token_max] = '\0';
+    *diag_out << endl;
+    *diag_out << "Around line: " << token_line << ", " << length << " characters, at most " << token_max
+              << ": " << token_text << "..." << endl;
+    return t_none;
+}
+
+static token scan_text() {
+    int i = 0;              /* index into token_text */
+
+    token_image = token_text;
 
     /* skip white space */
     while (isspace(c)) {
         c = lineno_get();
     }
-    if (cin.eof())
+    token_line = lineno;
+    if (scan_eof)
         return t_eof;
     if (isalpha(c)) {
         do {
-            token_image[i++] = c;
+            if (i < token_max)
+                token_text[i] = c;
+            i++;
             c = lineno_get();
         } while (isalpha(c) || isdigit(c) || c == '_');
 
-        token_image[i] = '\0';
-        if (!strcmp(token_image, "if")) return t_if;
-        else if (!strcmp(token_image, "fi")) return t_fi;
-        else if (!strcmp(token_image, "do")) return t_do;
-        else if (!strcmp(token_image, "od")) return t_od;
-        else if (!strcmp(token_image, "read")) return t_read;
-        else if (!strcmp(token_image, "write")) return t_write;
-        else if (!strcmp(token_image, "check")) return t_check;
+        if (i > token_max)
+            return too_long(i);
+        token_text[i] = '\0';
+        if (!strcmp(token_text, "if")) return t_if;
+        else if (!strcmp(token_text, "fi")) return t_fi;
+        else if (!strcmp(token_text, "do")) return t_do;
+        else if (!strcmp(token_text, "od")) return t_od;
+        else if (!strcmp(token_text, "read")) return t_read;
+        else if (!strcmp(token_text, "write")) return t_write;
+        else if (!strcmp(token_text, "check")) return t_check;
         else return t_id;
     } else if (isdigit(c)) {
         do {
-            token_image[i++] = c;
+            if (i < token_max)
+                token_text[i] = c;
+            i++;
             c = lineno_get();
         } while (isdigit(c));
 
-        token_image[i] = '\0';
+        if (i > token_max)
+            return too_long(i);
+        token_text[i] = '\0';
         return t_literal;
     } else {
         switch (c) {
             case ':':
-                token_image[0] = ':';
+                token_text[0] = ':';
                 if ((c = lineno_get()) != '=') {
-                    token_image[1] = c;
-                    token_image[2] = '\0';
+                    token_text[1] = c;
+                    token_text[2] = '\0';
 
-                    cerr << endl;
-                    cerr << "Around line: " << lineno << ", expect: := , get: :" << char(c) << endl;
+                    *diag_out << endl;
+                    *diag_out << "Around line: " << lineno << ", expect: := , get: :" << char(c) << endl;
                     return t_none;
                 } else {
                     c = lineno_get();
-                    token_image[1] = '=';
-                    token_image[2] = '\0';
+                    token_text[1] = '=';
+                    token_text[2] = '\0';
                     return t_gets;
                 }
                 break;
             case '+':
-                token_image[0] = '+';
-                token_image[1] = '\0';
+                token_text[0] = '+';
+                token_text[1] = '\0';
                 c = lineno_get();
                 return t_add;
             case '-':
-                token_image[0] = '-';
-                token_image[1] = '\0';
+                token_text[0] = '-';
+                token_text[1] = '\0';
                 c = lineno_get();
                 return t_sub;
             case '*':
-                token_image[0] = '*';
-                token_image[1] = '\0';
+                token_text[0] = '*';
+                token_text[1] = '\0';
                 c = lineno_get();
                 return t_mul;
             case '/':
-                token_image[0] = '/';
-                token_image[1] = '\0';
+                token_text[0] = '/';
+                token_text[1] = '\0';
                 c = lineno_get();
                 return t_div;
             case '(':
-                token_image[0] = '(';
-                token_image[1] = '\0';
+                token_text[0] = '(';
+                token_text[1] = '\0';
                 c = lineno_get();
                 return t_lparen;
             case ')':
-                token_image[0] = ')';
-                token_image[1] = '\0';
+                token_text[0] = ')';
+                token_text[1] = '\0';
                 c = lineno_get();
                 return t_rparen;
             case '=':
-                token_image[0] = '=';
+                token_text[0] = '=';
                 if ((c = lineno_get()) != '=') {
-                    token_image[1] = c;
-                    token_image[2] = '\0';
-                    cerr << endl;
-                    cerr << "Around line: " << lineno << ", expect: == , get: =" << char(c) << endl;
+                    token_text[1] = c;
+                    token_text[2] = '\0';
+                    *diag_out << endl;
+                    *diag_out << "Around line: " << lineno << ", expect: == , get: =" << char(c) << endl;
                     return t_none;
                 } else {
-                    token_image[1] = '=';
-                    token_image[2] = '\0';
+                    token_text[1] = '=';
+                    token_text[2] = '\0';
                     c = lineno_get();
                     return t_eq;
                 }
             case '<':
-                token_image[0] = '<';
+                token_text[0] = '<';
                 c = lineno_get();
                 if (c == '>') {
-                    token_image[1] = '>';
-                    token_image[2] = '\0';
+                    token_text[1] = '>';
+                    token_text[2] = '\0';
                     c = lineno_get();
                     return t_noteq;
                 } else if (c == '=') {
-                    token_image[1] = '=';
-                    token_image[2] = '\0';
+                    token_text[1] = '=';
+                    token_text[2] = '\0';
                     c = lineno_get();
                     return t_lte;
                 } else if (c == ' ') {
-                    token_image[1] = '\0';
+                    token_text[1] = '\0';
                     c = lineno_get();
                     return t_lt;
                 } else {
-                    token_image[1] = c;
-                    token_image[2] = '\0';
-                    cerr << endl;
-                    cerr << "Around line: " << lineno << ", expect: <= or <> , get: <" << char(c) << endl;
+                    token_text[1] = c;
+                    token_text[2] = '\0';
+                    *diag_out << endl;
+                    *diag_out << "Around line: " << lineno << ", expect: <= or <> , get: <" << char(c) << endl;
                     return t_none;
                 }
             case '>':
-                token_image[0] = '>';
+                token_text[0] = '>';
                 c = lineno_get();
                 if (c == '=') {
-                    token_image[1] = '=';
-                    token_image[2] = '\0';
+                    token_text[1] = '=';
+                    token_text[2] = '\0';
                     c = lineno_get();
                     return t_gte;
                 } else if (c == ' ') {
-                    token_image[1] = '\0';
+                    token_text[1] = '\0';
                     c = lineno_get();
                     return t_gt;
                 } else {
-                    token_image[1] = c;
-                    token_image[2] = '\0';
-                    cerr << endl;
-                    cerr << "Around line: " << lineno << ", expect: >= , get: >" << char(c) << endl;
+                    token_text[1] = c;
+                    token_text[2] = '\0';
+                    *diag_out << endl;
+                    *diag_out << "Around line: " << lineno << ", expect: >= , get: >" << char(c) << endl;
                     return t_none;
                 }
             default:
-                token_image[0] = c;
-                token_image[1] = '\0';
-                cerr << endl;
-                cerr << "Around line: " << lineno << ", get: " << char(c) << endl;
+                token_text[0] = c;
+                token_text[1] = '\0';
+                *diag_out << endl;
+                *diag_out << "Around line: " << lineno << ", get: " << char(c) << endl;
+                c = lineno_get();
                 return t_none;
         }
     }
 }
+
+static token replay() {
+    while (replay_chunk < chunks.size() && replay_token == chunks[replay_chunk].tokens.size()) {
+        // a streamed batch makes way for the next one, up to the one ending in eof
+        token_chunk& done = chunks[replay_chunk];
+        if (more_tokens && (done.tokens.empty() || done.tokens.back().type != t_eof)) {
+            // the image of the last token must outlive the batch, eof keeps it
+            if (token_image != token_text) {
+                strcpy(token_text, token_image);
+                token_image = token_text;
+            }
+            more_tokens(done, tokens_context);
+            replay_token = 0;
+            continue;
+        }
+        replay_chunk++;
+        replay_token = 0;
+    }
+    // past the end, the text scanner keeps returning eof too
+    if (replay_chunk == chunks.size())
+        return t_eof;
+
+    const token_chunk& chunk = chunks[replay_chunk];
+    const scanned_token& t = chunk.tokens[replay_token++];
+    if (t.message >= 0)
+        *diag_out << chunk.messages[t.message];
+    lineno = t.line;
+    token_line = t.start;
+    // read in place, no copy
+    if (fixed_images[t.type])
+        token_image = fixed_images[t.type];
+    else if (t.type != t_eof)
+        token_image = &chunk.images[t.image];
+    return t.type;
+}
+
+token scan() {
+    if (replaying)
+        return replay();
+    return scan_text();
+}
+
+/*
+ * up to max tokens into chunk, with the line numbers and messages scan()
+ * gives for them; the scanner reports to messages. True at the end of the
+ * text, which is a token of its own only in the last chunk
+ */
+static bool scan_tokens(token_chunk& chunk, ostringstream& messages, bool last, size_t max) {
+    for (size_t n = 0; n < max; n++) {
+        token type = scan_text();
+        if (type == t_eof && !last)
+            return true;
+
+        scanned_token t = {type, lineno, token_line, (unsigned) chunk.images.size(), -1};
+        // the scanner only reports when it gives up on a token
+        if (type == t_none && messages.tellp() > 0) {
+            t.message = chunk.messages.size();
+            chunk.messages.push_back(messages.str());
+            messages.str("");
+        }
+        if (!fixed_images[type] && type != t_eof)
+            chunk.images.insert(chunk.images.end(), token_text, token_text + strlen(token_text) + 1);
+        chunk.tokens.push_back(t);
+        if (type == t_eof)
+            return true;
+    }
+    return false;
+}
+
+// on a thread of its own: the tokens, line numbers and messages scan() gives for the chunk
+static void scan_chunk(token_chunk& chunk, bool last) {
+    ostringstream messages;
+    scan_reset(chunk.text, chunk.size, messages);
+    lineno = chunk.first_line;
+    chunk.tokens.clear();
+    chunk.images.clear();
+    chunk.messages.clear();
+    // most tokens take two characters or more with the blank after them
+    chunk.tokens.reserve(chunk.size / 2 + 1);
+    chunk.images.reserve(chunk.size / 2);
+    scan_tokens(chunk, messages, last, SIZE_MAX);
+}
+
+static thread_local ostringstream stream_messages;
+
+void scan_source(text_source source, void* context) {
+    scan_reset(NULL, 0, stream_messages);
+    more_text = source;
+    text_context = context;
+}
+
+bool scan_batch(token_chunk& batch, size_t max) {
+    batch.tokens.clear();
+    batch.images.clear();
+    batch.messages.clear();
+    return scan_tokens(batch, stream_messages, true, max);
+}
+
+void scan_stream(batch_source source, void* context, ostream& diag) {
+    scan_reset(NULL, 0, diag);
+    chunks.assign(1, token_chunk());
+    more_tokens = source;
+    tokens_context = context;
+    replaying = true;
+    replay_chunk = 0;
+    replay_token = 0;
+}
+
+void scan_parallel(int jobs) {
+    size_t size = scan_end - scan_pos;
+    size_t n = min((size_t) jobs * 4, size / min_chunk);
+
+    // cut after the first newline past every n-th of the text
+    vector<const char*> cuts(1, scan_pos);
+    for (size_t i = 1; i < n; i++) {
+        const char* target = scan_pos + size * i / n;
+        if (target < cuts.back())
+            continue;
+        const char* newline = (const char*) memchr(target, '\n', scan_end - target);
+        if (!newline || newline + 1 == scan_end)
+            break;
+        cuts.push_back(newline + 1);
+    }
+    cuts.push_back(scan_end);
+    size_t count = cuts.size() - 1;
+    if (count < 2)
+        return;
+
+    // `chunks` is thread_local, the workers must fill this thread's
+    vector<token_chunk>& ahead = chunks;
+    ahead.resize(count);
+    vector<int> newlines(count);
+    parallel_for(count, jobs, [&](int i) {
+        ahead[i].text = cuts[i];
+        ahead[i].size = cuts[i + 1] - cuts[i];
+        newlines[i] = std::count(cuts[i], cuts[i + 1], '\n');
+    });
+    // a chunk starts right after a newline, so its first line is known up front
+    int line = lineno;
+    for (size_t i = 0; i < count; i++) {
+        ahead[i].first_line = line;
+        line += newlines[i];
+    }
+    parallel_for(count, jobs, [&](int i) {
+        mem_scope scope(mem_tokens);
+        trace_span span("scan chunk", ahead[i].first_line);
+        scan_chunk(ahead[i], i == (int) count - 1);
+    });
+
+    replaying = true;
+    replay_chunk = 0;
+    replay_token = 0;
+}
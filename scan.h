@@ -5,6 +5,10 @@
 #ifndef __SCAN_H
 #define __SCAN_H
 
+#include <iostream>
+#include <string>
+#include <vector>
+
 enum token {
     t_read, t_write, t_id, t_literal, t_gets,
     t_add, t_sub, t_mul, t_div, t_lparen, t_rparen, t_eof,
@@ -12,11 +16,71 @@ enum token {
     t_eq, t_noteq, t_lt, t_gt, t_lte, t_gte, t_none
 };
 
-extern char token_image[100];
+// text of the current token, valid until the next scan()
+extern thread_local const char* token_image;
+
+// the longest id or literal, what st::id and bin_op::name hold; a longer one is a t_none
+const int token_max = 99;
 
 extern token scan();
 extern token get_next_token();
 
-extern int lineno;
+extern thread_local int lineno;
+// line the current token starts on; lineno is already past a newline read after it
+extern thread_local int token_line;
+
+/*
+ * scanner state is per thread, so that the server (serve.cpp) can run one
+ * compilation per worker; scan_reset points it at the program text, held in
+ * memory, and at the stream errors are reported to
+ */
+extern thread_local std::ostream* diag_out;
+
+void scan_reset(const char* text, size_t size, std::ostream& diag);
+
+/*
+ * parallel front end: the text is cut at newlines (no token spans one), the
+ * pieces are scanned on separate threads into token arrays with the line
+ * numbers and error messages scan() would have produced, and scan() then
+ * hands the tokens out in order; inputs too small to be worth it are left
+ * to be scanned lazily as before
+ */
+struct scanned_token {
+    token type;
+    int line;               // lineno after the token
+    int start;              // token_line
+    unsigned image;         // offset of token_image in the chunk's images
+    int message;            // index into the chunk's messages, -1 for none
+};
+
+struct token_chunk {
+    const char* text;
+    size_t size;
+    int first_line;
+    std::vector<scanned_token> tokens;
+    std::vector<char> images;
+    std::vector<std::string> messages;
+};
+
+// scan the text given to scan_reset ahead of the parser on up to jobs threads
+void scan_parallel(int jobs);
+
+/*
+ * streamed front end (pipeline.h), scanner and parser on threads of their
+ * own. On the scanning thread the text comes in blocks from a text_source,
+ * which gives the next one (valid until it is asked again) or returns false
+ * at the end of the input, and scan_batch cuts the tokens into batches. On
+ * the parsing thread scan() hands out the tokens of the batches a
+ * batch_source gives, in order, up to the batch ending in eof
+ */
+typedef bool (*text_source)(const char** text, size_t* size, void* context);
+typedef void (*batch_source)(token_chunk& batch, void* context);
+
+void scan_source(text_source source, void* context);
+
+// the next tokens, max at most, true once the batch ends in eof
+bool scan_batch(token_chunk& batch, size_t max);
+
+void scan_stream(batch_source source, void* context, std::ostream& diag);
 
 #endif
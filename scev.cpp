@@ -0,0 +1,263 @@
+#include "scev.h"
+#include <algorithm>
+#include <cstdlib>
+#include <set>
+
+using namespace std;
+
+// the value the variable being solved has when an iteration starts, in the products of its coefficients
+static const string start_of_iteration = "";
+
+// degree of any value in the body, the sum of one is a degree higher
+static const size_t max_degree = 4;
+
+static void add_to(scev_coefficient& sum, const vector<string>& product, uint64_t times) {
+    uint64_t& c = sum[product];
+    c += times;
+    if (c == 0)
+        sum.erase(product);
+}
+
+static scev_coefficient times(const scev_coefficient& a, const scev_coefficient& b) {
+    scev_coefficient product;
+    for (scev_coefficient::const_iterator x = a.begin(); x != a.end(); x++) {
+        for (scev_coefficient::const_iterator y = b.begin(); y != b.end(); y++) {
+            vector<string> names(x->first);
+            names.insert(names.end(), y->first.begin(), y->first.end());
+            sort(names.begin(), names.end());
+            add_to(product, names, x->second * y->second);
+        }
+    }
+    return product;
+}
+
+static void trim(scev_poly& p) {
+    while (!p.empty() && p.back().empty())
+        p.pop_back();
+}
+
+// value times the one name given, a number without one
+static scev_poly constant(uint64_t value, const char* name) {
+    scev_poly p(1);
+    if (value != 0)
+        p[0][name ? vector<string>(1, name) : vector<string>()] = value;
+    trim(p);
+    return p;
+}
+
+// a + sign b, sign 1 or -1 (wrapping)
+static scev_poly add(const scev_poly& a, const scev_poly& b, uint64_t sign) {
+    scev_poly sum(a);
+    sum.resize(max(a.size(), b.size()));
+    for (size_t m = 0; m < b.size(); m++)
+        for (scev_coefficient::const_iterator t = b[m].begin(); t != b[m].end(); t++)
+            add_to(sum[m], t->first, sign * t->second);
+    trim(sum);
+    return sum;
+}
+
+static uint64_t factorial(int n) {
+    return n <= 1 ? 1 : n * factorial(n - 1);
+}
+
+// C(k, a) C(k, b) = sum over c of this times C(k, c), max(a, b) <= c <= a + b
+static uint64_t binomial_product(int a, int b, int c) {
+    return factorial(c) / (factorial(c - a) * factorial(c - b) * factorial(a + b - c));
+}
+
+static bool multiply(const scev_poly& a, const scev_poly& b, scev_poly& product) {
+    product.clear();
+    if (a.empty() || b.empty())
+        return true;
+    if (a.size() + b.size() - 2 > max_degree)
+        return false;
+    product.resize(a.size() + b.size() - 1);
+    for (size_t i = 0; i < a.size(); i++) {
+        for (size_t j = 0; j < b.size(); j++) {
+            scev_coefficient ab = times(a[i], b[j]);
+            for (size_t c = max(i, j); c <= i + j; c++)
+                for (scev_coefficient::const_iterator t = ab.begin(); t != ab.end(); t++)
+                    add_to(product[c], t->first, binomial_product(i, j, c) * t->second);
+        }
+    }
+    trim(product);
+    return true;
+}
+
+// what a value in the body is, while it is being worked out
+struct scev_value {
+    bool known;
+    scev_poly p;
+};
+
+struct scev_state {
+    const set<string>* assigned;
+    map<string, scev_poly> values;      // this iteration so far, missing: not known
+};
+
+static scev_value evaluate(bin_op* node, const scev_state& state) {
+    scev_value v = {false, scev_poly()};
+    if (node->type == t_literal) {
+        v.known = true;
+        v.p = constant(strtoull(node->name, NULL, 10), NULL);
+        return v;
+    }
+    if (node->type == t_id) {
+        map<string, scev_poly>::const_iterator found = state.values.find(node->name);
+        if (found != state.values.end()) {
+            v.known = true;
+            v.p = found->second;
+        } else if (state.assigned->find(node->name) == state.assigned->end()) {
+            // the same in every iteration
+            v.known = true;
+            v.p = constant(1, node->name);
+        }
+        return v;
+    }
+    if (node->type != t_add && node->type != t_sub && node->type != t_mul)
+        return v;
+
+    scev_value l = evaluate(node->l_child, state);
+    scev_value r = evaluate(node->r_child, state);
+    if (!l.known || !r.known)
+        return v;
+    if (node->type == t_mul) {
+        v.known = multiply(l.p, r.p, v.p);
+    } else {
+        v.known = true;
+        v.p = add(l.p, r.p, node->type == t_add ? 1 : (uint64_t) -1);
+    }
+    return v;
+}
+
+// one pass over the body with var at its start of iteration value
+static scev_value iterate(st_list* first, st_list* last, const char* var, scev_state state) {
+    state.values[var] = constant(1, start_of_iteration.c_str());
+    for (st_list* sl = first; sl != last; sl = sl->r_child) {
+        st* s = sl->l_child;
+        if (!s)
+            continue;
+        scev_value v = evaluate(s->rel, state);
+        if (v.known)
+            state.values[s->id] = v.p;
+        else
+            state.values.erase(s->id);
+    }
+    scev_value result = {false, scev_poly()};
+    map<string, scev_poly>::const_iterator found = state.values.find(var);
+    if (found != state.values.end()) {
+        result.known = true;
+        result.p = found->second;
+    }
+    return result;
+}
+
+// value(k - 1) over C(k, j): C(k - 1, m) is the sum over j <= m of (-1)^(m - j) C(k, j)
+static scev_poly one_before(const scev_poly& value) {
+    scev_poly shifted(value.size());
+    for (size_t m = 0; m < value.size(); m++)
+        for (size_t j = 0; j <= m; j++)
+            for (scev_coefficient::const_iterator t = value[m].begin(); t != value[m].end(); t++)
+                add_to(shifted[j], t->first, ((m - j) % 2 ? (uint64_t) -1 : 1) * t->second);
+    trim(shifted);
+    return shifted;
+}
+
+/*
+ * what var is from what one iteration leaves in it: the start value times a
+ * ratio plus the rest, where the rest does not depend on the start value
+ */
+static bool classify(const string& var, const scev_poly& after, scev_final& final, scev_poly& start) {
+    scev_coefficient ratio;
+    scev_poly rest(after.size());
+    for (size_t m = 0; m < after.size(); m++) {
+        for (scev_coefficient::const_iterator t = after[m].begin(); t != after[m].end(); t++) {
+            size_t uses = count(t->first.begin(), t->first.end(), start_of_iteration);
+            if (uses == 0) {
+                rest[m][t->first] = t->second;
+                continue;
+            }
+            if (uses > 1 || m > 0)
+                return false;
+            ratio[vector<string>(t->first.begin() + 1, t->first.end())] = t->second;
+        }
+    }
+    trim(rest);
+
+    final.var = var;
+    if (ratio.empty()) {
+        final.kind = e_last;
+        final.value = one_before(rest);
+        return true;
+    }
+    scev_coefficient one;
+    one[vector<string>()] = 1;
+    if (ratio == one) {
+        // var(k) = var(0) + the rest of the iterations before k
+        if (rest.size() > max_degree)
+            return false;
+        start = constant(1, var.c_str());
+        start.resize(rest.size() + 1);
+        for (size_t m = 0; m < rest.size(); m++)
+            start[m + 1] = rest[m];
+        trim(start);
+        final.kind = e_polynomial;
+        final.value = start;
+        return true;
+    }
+    if (!rest.empty())
+        return false;
+    final.kind = e_geometric;
+    final.ratio = ratio;
+    return true;
+}
+
+bool solve_loop(st* loop, scev_loop& result) {
+    counted_loop& shape = result.shape;
+    if (!recognize_counted_loop(loop, shape))
+        return false;
+    for (st_list* sl = shape.first; sl != shape.last; sl = sl->r_child)
+        if (sl->l_child && sl->l_child->type != t_id)
+            return false;
+
+    set<string> assigned;
+    collect_assigned(shape.first, assigned);
+    scev_state state;
+    state.assigned = &assigned;
+
+    // i0 + c C(k, 1), minus c when counting down
+    scev_poly induction = constant(1, shape.var);
+    induction.resize(2);
+    induction[1][vector<string>()] = shape.up ? strtoull(shape.stride, NULL, 10) : -strtoull(shape.stride, NULL, 10);
+    state.values[shape.var] = induction;
+
+    map<string, scev_final> solved;
+    solved[shape.var].var = shape.var;
+    solved[shape.var].kind = e_polynomial;
+    solved[shape.var].value = induction;
+
+    // a polynomial variable can be read before it is assigned, once it is known the others may use it
+    for (bool progress = true; progress; ) {
+        progress = false;
+        for (set<string>::iterator it = assigned.begin(); it != assigned.end(); it++) {
+            if (solved.find(*it) != solved.end())
+                continue;
+            scev_value after = iterate(shape.first, shape.last, it->c_str(), state);
+            scev_final final;
+            scev_poly start;
+            if (!after.known || !classify(*it, after.p, final, start))
+                continue;
+            if (final.kind == e_polynomial)
+                state.values[*it] = start;
+            solved[*it] = final;
+            progress = true;
+        }
+    }
+    if (solved.size() != assigned.size())
+        return false;
+
+    result.finals.clear();
+    for (map<string, scev_final>::iterator it = solved.begin(); it != solved.end(); it++)
+        result.finals.push_back(it->second);
+    return true;
+}
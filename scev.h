@@ -0,0 +1,58 @@
+#ifndef __SCEV_H
+#define __SCEV_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "ast.h"
+#include "loop.h"
+
+/*
+ * scalar evolution of counted loops (loop.h), for loops compile.cpp replaces
+ * by what they leave behind
+ *
+ * The body runs straight through, assignments of +, - and * only. Every
+ * value in it is then a polynomial in the iteration number k, 0 for the
+ * first iteration, written over the binomials C(k, m): the induction
+ * variable is i0 + c C(k, 1), and a sum over the iterations before k just
+ * moves every term one degree up, C(k, m) to C(k, m + 1). Each variable the
+ * body assigns must turn out to be one of
+ * - a polynomial: s := s + e, e of degree 3 at most, the induction variable too
+ * - geometric: x := x * r, r the same in every iteration
+ * - the last value: the body assigns it from other values alone
+ * and whatever reads a geometric or last-value variable must read what this
+ * iteration assigned it. The coefficients are sums of products of the values
+ * the variables have when the loop starts, so they are computed when it
+ * starts, on 64 bits and wrapping like the loop's own adds and multiplies
+ * do: the final values agree with the loop modulo 2^64, and so in whatever
+ * narrower type a variable is declared in.
+ */
+
+// sum of products of variables (their values when the loop starts), by the sorted names of a product
+typedef std::map<std::vector<std::string>, uint64_t> scev_coefficient;
+
+// sum of coefficient m times C(k, m)
+typedef std::vector<scev_coefficient> scev_poly;
+
+enum scev_kind {
+    e_polynomial,   // value: in the number of iterations
+    e_geometric,    // the value it starts with, times ratio to the number of iterations
+    e_last          // value: in the number of iterations, unchanged when there are none
+};
+
+struct scev_final {
+    std::string var;
+    scev_kind kind;
+    scev_poly value;
+    scev_coefficient ratio;
+};
+
+struct scev_loop {
+    counted_loop shape;
+    std::vector<scev_final> finals;    // every variable the loop assigns, in name order
+};
+
+bool solve_loop(st* loop, scev_loop& result);
+
+#endif
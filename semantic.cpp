@@ -2,80 +2,65 @@
 
 using namespace std;
 
-bool correct_semantic = true;
-
-bool semantic_analysis(st_list* root) {
-    cout << endl << "[static semantic check]: test do has check" << endl;
-    analysis_do_has_check(root);
-    cout << "[static semantic check]: test check in do" << endl;
-    analysis_check_in_do(root, false);
-    return correct_semantic;
+void semantic_open_do(semantic_state& state) {
+    state.open.push_back(state.do_has_check.size());
+    state.do_has_check.push_back(false);
 }
 
-bool check_inside_do(st_list* root) {
-    if (root->l_child && root->l_child->type == t_check) {
-        return true;
-    }
-    else if (root->r_child) {
-        return check_inside_do(root->r_child);
-    }
-    else
-        return false;
+void semantic_open_if(semantic_state& state) {
+    state.open.push_back(-1);
 }
 
-void analysis_do_has_check(st_list *root) {
-    static int count = 1;
+void semantic_close(semantic_state& state) {
+    if (!state.open.empty())
+        state.open.pop_back();
+}
 
-    if (!root)
-        return;
+void semantic_check(semantic_state& state) {
+    bool in_do = !state.open.empty() && state.open.back() >= 0;
+    if (in_do)
+        state.do_has_check[state.open.back()] = true;
+    state.check_in_do.push_back(in_do);
+}
 
-    if (root->l_child) {
-        // see if check in do
-        // and at least one check is inside it ant not nested
-        if (root->l_child->type == t_do) {
-            if (!check_inside_do(root->l_child->sl)) {
-                cout << "do [" << count << "] has no check in it" << endl;
-                correct_semantic = false;
-            }
-            else {
-                cout << "do [" << count << "] has check in it" << endl;
-            }
-            count++;
-            analysis_do_has_check(root->l_child->sl);
-        }
+void semantic_unwind(semantic_state& state, size_t depth) {
+    if (state.open.size() > depth)
+        state.open.resize(depth);
+}
 
-        // should check do in if
-        if (root->l_child->type == t_if) {
-            analysis_do_has_check(root->l_child->sl);
-        }
-    }
+semantic_mark semantic_position(const semantic_state& state) {
+    semantic_mark mark = {state.do_has_check.size(), state.check_in_do.size()};
+    return mark;
+}
 
-    // goto find the next do
-    if (root->r_child) {
-        analysis_do_has_check(root->r_child);
-    }
+void semantic_rewind(semantic_state& state, semantic_mark mark) {
+    state.open.clear();
+    state.do_has_check.resize(mark.dos);
+    state.check_in_do.resize(mark.checks);
 }
 
-void analysis_check_in_do(st_list *root, bool is_check) {
-    static int count = 1;
+// report in the order of the do and check statements in the source
+bool semantic_analysis(const semantic_state& state, ostream& out) {
+    bool correct_semantic = true;
 
-    if (root->l_child && root->l_child->type == t_check) {
-        if (is_check) {
-            cout << "check [" << count << "] is in do" << endl;
-        }
-        else {
-            cout << "check [" << count << "] not in do" << endl;
+    out << endl << "[static semantic check]: test do has check" << endl;
+    for (size_t i = 0; i < state.do_has_check.size(); i++) {
+        if (state.do_has_check[i]) {
+            out << "do [" << i + 1 << "] has check in it" << endl;
+        } else {
+            out << "do [" << i + 1 << "] has no check in it" << endl;
             correct_semantic = false;
         }
-        count++;
-    }
-    else if (root->l_child && root->l_child->type == t_if) {
-        analysis_check_in_do(root->l_child->sl, false);
-    }
-    else if (root->l_child && root->l_child->type == t_do) {
-        analysis_check_in_do(root->l_child->sl, true);
     }
 
-    if (root->r_child)
-        analysis_check_in_do(root->r_child, is_check);
+    out << "[static semantic check]: test check in do" << endl;
+    for (size_t i = 0; i < state.check_in_do.size(); i++) {
+        if (state.check_in_do[i]) {
+            out << "check [" << i + 1 << "] is in do" << endl;
+        } else {
+            out << "check [" << i + 1 << "] not in do" << endl;
+            correct_semantic = false;
+        }
+    }
+    return correct_semantic;
 }
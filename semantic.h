@@ -1,11 +1,41 @@
 #ifndef __SEMANTIC_H
 #define __SEMANTIC_H
 
+#include <vector>
 #include "ast.h"
 #include "scan.h"
 
-bool semantic_analysis(st_list* root);
-void analysis_do_has_check(st_list *root);
-void analysis_check_in_do(st_list *root, bool is_check);
+/*
+ * static semantic check for do/check, done while parsing
+ * - every check statement appears inside a do statement
+ * - every do statement has at least one check that is inside it and not inside any nested do
+ *
+ * the parser opens a frame for every do and if it enters and reports every check;
+ * a check is in its do when the innermost open frame is that do
+ */
+struct semantic_state {
+    std::vector<bool> do_has_check;     // by do, in source order
+    std::vector<bool> check_in_do;      // by check, in source order
+    std::vector<int> open;              // open frames, innermost last: index into do_has_check, -1 for if
+};
+
+void semantic_open_do(semantic_state& state);
+void semantic_open_if(semantic_state& state);
+void semantic_close(semantic_state& state);
+void semantic_check(semantic_state& state);
+// drop frames left open by a statement that error recovery abandoned
+void semantic_unwind(semantic_state& state, size_t depth);
+
+// how many dos and checks were seen when a program started
+struct semantic_mark {
+    size_t dos;
+    size_t checks;
+};
+
+semantic_mark semantic_position(const semantic_state& state);
+// error recovery starts the program over: forget the dos and checks seen since mark, their statements are gone
+void semantic_rewind(semantic_state& state, semantic_mark mark);
+
+bool semantic_analysis(const semantic_state& state, std::ostream& out);
 
 #endif
@@ -0,0 +1,91 @@
+#include "serve.h"
+#include "protocol.h"
+#include "parse.h"
+#include "calc.h"
+#include "pool.h"
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace std;
+
+// one request per connection, on a worker thread
+static void handle(int fd) {
+    string request;
+
+    if (read_all(fd, request)) {
+        size_t eol = request.find('\n');
+        istringstream flags(request.substr(0, eol));
+        string_view source(request);
+        source.remove_prefix(eol == string::npos ? request.size() : eol + 1);
+
+        calc::Options options;
+        calc::CompileResult result;
+        ostringstream unknown;
+        string flag;
+        while (flags >> flag) {
+            if (!parse_option(flag.c_str(), options))
+                unknown << "unknown option: " << flag << endl;
+        }
+        if (unknown.str().empty())
+            result = calc::compile(source, options);
+        else
+            result.diagnostics = unknown.str();
+
+        string reply;
+        add_section(reply, "out", result.ast + result.report);
+        add_section(reply, "diag", result.diagnostics);
+        add_section(reply, "c", result.code);
+        write_all(fd, reply.data(), reply.size());
+    }
+    close(fd);
+}
+
+int serve(const char* path, int workers) {
+    // a client that goes away must not take the server with it
+    signal(SIGPIPE, SIG_IGN);
+
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        cerr << "socket path too long: " << path << endl;
+        return 1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        perror("socket");
+        return 1;
+    }
+    unlink(path);
+    if (bind(listener, (sockaddr*) &addr, sizeof(addr)) < 0 || listen(listener, 128) < 0) {
+        perror(path);
+        close(listener);
+        return 1;
+    }
+    cerr << "serving on " << path << " with " << workers << " workers" << endl;
+
+    worker_pool pool(workers, handle);
+    for (;;) {
+        int connection = accept(listener, NULL, NULL);
+        if (connection < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            perror("accept");
+            break;
+        }
+        pool.submit(connection);
+    }
+    close(listener);
+    unlink(path);
+    return 1;
+}
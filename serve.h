@@ -0,0 +1,11 @@
+#ifndef __SERVE_H
+#define __SERVE_H
+
+/*
+ * `parse --serve <socket>` keeps one process up and runs every connection on
+ * a Unix domain socket through translate(), on a pool of worker threads;
+ * the request and reply format is in protocol.h
+ */
+int serve(const char* path, int workers);
+
+#endif
@@ -0,0 +1,344 @@
+#include "ssa.h"
+#include "loop.h"
+#include <set>
+#include <sstream>
+
+using namespace std;
+
+struct ssa_builder {
+    ssa_program* program;
+    map<string, int> current;           // variable -> its live value
+    map<string, int> versions;          // variable -> last version number handed out
+    map<string, int> initial;           // variable -> value it has before any assignment
+    int temporaries;
+    vector<ssa_inst*> loops;            // innermost loop on top
+};
+
+static void build_list(ssa_builder& b, st_list* sl, vector<ssa_inst>& out);
+
+static int new_value(ssa_builder& b, const string& name, const string& var, bin_op* node, bool constant) {
+    ssa_value v;
+    v.name = name;
+    v.var = var;
+    v.node = node;
+    v.constant = constant;
+    b.program->values.push_back(v);
+    return b.program->values.size() - 1;
+}
+
+static int new_version(ssa_builder& b, const string& var) {
+    ostringstream name;
+    name << var << "_" << ++b.versions[var];
+    return new_value(b, name.str(), var, NULL, false);
+}
+
+static int new_temporary(ssa_builder& b, bin_op* node) {
+    ostringstream name;
+    name << "t" << ++b.temporaries;
+    return new_value(b, name.str(), "", node, false);
+}
+
+// the variable before any assignment, declared at the top of main as 0 like the globals of the AST backend
+static int initial_value(ssa_builder& b, const string& var) {
+    map<string, int>::iterator found = b.initial.find(var);
+    if (found != b.initial.end())
+        return found->second;
+
+    int v = new_value(b, var + "_0", var, NULL, false);
+    b.initial[var] = v;
+    b.program->initial.push_back(v);
+    return v;
+}
+
+static int lookup(ssa_builder& b, const string& var) {
+    map<string, int>::iterator found = b.current.find(var);
+    if (found != b.current.end())
+        return found->second;
+    return initial_value(b, var);
+}
+
+static ssa_inst make_inst(ssa_kind kind) {
+    ssa_inst inst;
+    inst.kind = kind;
+    inst.def = -1;
+    inst.args[0] = inst.args[1] = -1;
+    inst.node = NULL;
+    inst.hoisted = false;
+    return inst;
+}
+
+// the value of the expression, named after `target` when it is an operator
+static int build_expr(ssa_builder& b, bin_op* node, const string& target, vector<ssa_inst>& out) {
+    if (node->type == t_literal)
+        return new_value(b, node->name, "", node, true);
+    if (node->type == t_id)
+        return lookup(b, node->name);
+    if (!node->l_child || !node->r_child)
+        return new_value(b, "0", "", node, true);   // left behind by error recovery
+
+    ssa_inst inst = make_inst(s_binary);
+    inst.args[0] = build_expr(b, node->l_child, "", out);
+    inst.args[1] = build_expr(b, node->r_child, "", out);
+    inst.node = node;
+    inst.def = target.empty() ? new_temporary(b, node) : new_version(b, target);
+    out.push_back(inst);
+    return inst.def;
+}
+
+// checks that leave this loop: its own and those inside its ifs
+static int count_exits(st_list* sl) {
+    int n = 0;
+    for (; sl != NULL; sl = sl->r_child) {
+        if (!sl->l_child)
+            continue;
+        if (sl->l_child->type == t_check)
+            n++;
+        else if (sl->l_child->type == t_if)
+            n += count_exits(sl->l_child->sl);
+    }
+    return n;
+}
+
+static void build_loop(ssa_builder& b, st_list* body, vector<ssa_inst>& out) {
+    out.push_back(make_inst(s_loop));
+    ssa_inst& loop = out.back();
+
+    set<string> assigned;
+    collect_assigned(body, assigned);
+
+    for (set<string>::iterator it = assigned.begin(); it != assigned.end(); it++) {
+        ssa_phi phi;
+        phi.args[0] = lookup(b, *it);
+        phi.def = new_version(b, *it);
+        phi.args[1] = -1;
+        loop.phis.push_back(phi);
+    }
+    for (size_t i = 0; i < loop.phis.size(); i++)
+        b.current[b.program->values[loop.phis[i].def].var] = loop.phis[i].def;
+
+    st_list* rest = body;
+    loop.hoisted = body && body->l_child && body->l_child->type == t_check && count_exits(body) == 1;
+    if (loop.hoisted) {
+        loop.node = body->l_child->rel;
+        loop.header = b.current;
+        rest = body->r_child;
+    } else {
+        for (size_t i = 0; i < loop.phis.size(); i++) {
+            ssa_phi exit;
+            exit.args[0] = loop.phis[i].args[0];
+            exit.args[1] = -1;
+            exit.def = new_version(b, b.program->values[loop.phis[i].def].var);
+            loop.exits.push_back(exit);
+        }
+    }
+
+    // `out` may grow while the body is built, keep the loop by index
+    size_t index = out.size() - 1;
+    vector<ssa_inst> inner;
+    b.loops.push_back(&out[index]);
+    build_list(b, rest, inner);
+    b.loops.pop_back();
+
+    ssa_inst& built = out[index];
+    built.body.swap(inner);
+    for (size_t i = 0; i < built.phis.size(); i++)
+        built.phis[i].args[1] = b.current[b.program->values[built.phis[i].def].var];
+
+    // after the loop a variable holds what it had when the loop was left
+    for (size_t i = 0; i < built.phis.size(); i++) {
+        const string& var = b.program->values[built.phis[i].def].var;
+        b.current[var] = built.hoisted ? built.phis[i].def : built.exits[i].def;
+    }
+}
+
+static void build_stmt(ssa_builder& b, st* s, vector<ssa_inst>& out) {
+    ssa_inst inst = make_inst(s_copy);
+    map<string, int> before;
+
+    switch (s->type) {
+        case t_id:
+            if (s->rel->l_child && s->rel->r_child) {
+                b.current[s->id] = build_expr(b, s->rel, s->id, out);
+            } else {
+                inst.args[0] = build_expr(b, s->rel, "", out);
+                inst.def = new_version(b, s->id);
+                b.current[s->id] = inst.def;
+                out.push_back(inst);
+            }
+            break;
+        case t_read:
+            // a read that finds no number keeps what the variable held
+            inst.kind = s_read;
+            inst.args[0] = lookup(b, s->id);
+            inst.def = new_version(b, s->id);
+            b.current[s->id] = inst.def;
+            out.push_back(inst);
+            break;
+        case t_write:
+            inst.kind = s_write;
+            inst.node = s->rel;
+            inst.args[0] = build_expr(b, s->rel, "", out);
+            out.push_back(inst);
+            break;
+        case t_if:
+            inst.kind = s_if;
+            inst.node = s->rel;
+            inst.args[0] = build_expr(b, s->rel, "", out);
+
+            before = b.current;
+            build_list(b, s->sl, inst.body);
+
+            for (map<string, int>::iterator it = b.current.begin(); it != b.current.end(); it++) {
+                map<string, int>::iterator prev = before.find(it->first);
+                if (prev != before.end() && prev->second == it->second)
+                    continue;
+                ssa_phi phi;
+                phi.args[0] = prev != before.end() ? prev->second : initial_value(b, it->first);
+                phi.args[1] = it->second;
+                phi.def = new_version(b, it->first);
+                inst.phis.push_back(phi);
+            }
+            b.current = before;
+            for (size_t i = 0; i < inst.phis.size(); i++)
+                b.current[b.program->values[inst.phis[i].def].var] = inst.phis[i].def;
+            out.push_back(inst);
+            break;
+        case t_do:
+            build_loop(b, s->sl, out);
+            break;
+        case t_check:
+            inst.kind = s_check;
+            inst.node = s->rel;
+            inst.args[0] = build_expr(b, s->rel, "", out);
+            if (!b.loops.empty()) {
+                ssa_inst* loop = b.loops.back();
+                for (size_t i = 0; i < loop->exits.size(); i++) {
+                    const string& var = b.program->values[loop->exits[i].def].var;
+                    inst.copies.push_back(make_pair(loop->exits[i].def, b.current[var]));
+                }
+            }
+            out.push_back(inst);
+            break;
+        default:
+            break;
+    }
+}
+
+static void build_list(ssa_builder& b, st_list* sl, vector<ssa_inst>& out) {
+    for (; sl != NULL; sl = sl->r_child) {
+        if (sl->l_child)
+            build_stmt(b, sl->l_child, out);
+    }
+}
+
+/*
+ * pruning: a phi node only survives if its value is used by a real
+ * instruction, directly or through other phi nodes and exit copies
+ */
+static void mark(vector<bool>& live, int v) {
+    if (v >= 0)
+        live[v] = true;
+}
+
+static void mark_condition(const ssa_inst& loop, bin_op* node, vector<bool>& live) {
+    if (node->type == t_id) {
+        map<string, int>::const_iterator found = loop.header.find(node->name);
+        if (found != loop.header.end())
+            mark(live, found->second);
+    }
+    if (node->l_child)
+        mark_condition(loop, node->l_child, live);
+    if (node->r_child)
+        mark_condition(loop, node->r_child, live);
+}
+
+static void mark_roots(const vector<ssa_inst>& body, vector<bool>& live) {
+    for (size_t i = 0; i < body.size(); i++) {
+        const ssa_inst& inst = body[i];
+        if (inst.kind != s_loop) {
+            mark(live, inst.args[0]);
+            mark(live, inst.args[1]);
+        } else if (inst.hoisted) {
+            mark_condition(inst, inst.node, live);
+        }
+        mark_roots(inst.body, live);
+    }
+}
+
+static bool mark_phis(const vector<ssa_phi>& phis, vector<bool>& live) {
+    bool changed = false;
+    for (size_t i = 0; i < phis.size(); i++) {
+        if (!live[phis[i].def])
+            continue;
+        for (int j = 0; j < 2; j++) {
+            if (phis[i].args[j] >= 0 && !live[phis[i].args[j]]) {
+                live[phis[i].args[j]] = true;
+                changed = true;
+            }
+        }
+    }
+    return changed;
+}
+
+static bool mark_edges(const vector<ssa_inst>& body, vector<bool>& live) {
+    bool changed = false;
+    for (size_t i = 0; i < body.size(); i++) {
+        const ssa_inst& inst = body[i];
+        changed |= mark_phis(inst.phis, live);
+        changed |= mark_phis(inst.exits, live);
+        for (size_t j = 0; j < inst.copies.size(); j++) {
+            if (live[inst.copies[j].first] && !live[inst.copies[j].second]) {
+                live[inst.copies[j].second] = true;
+                changed = true;
+            }
+        }
+        changed |= mark_edges(inst.body, live);
+    }
+    return changed;
+}
+
+static void drop_phis(vector<ssa_phi>& phis, const vector<bool>& live) {
+    vector<ssa_phi> kept;
+    for (size_t i = 0; i < phis.size(); i++)
+        if (live[phis[i].def])
+            kept.push_back(phis[i]);
+    phis.swap(kept);
+}
+
+static void drop_dead(vector<ssa_inst>& body, const vector<bool>& live) {
+    for (size_t i = 0; i < body.size(); i++) {
+        ssa_inst& inst = body[i];
+        drop_phis(inst.phis, live);
+        drop_phis(inst.exits, live);
+
+        vector<pair<int, int> > copies;
+        for (size_t j = 0; j < inst.copies.size(); j++)
+            if (live[inst.copies[j].first])
+                copies.push_back(inst.copies[j]);
+        inst.copies.swap(copies);
+
+        drop_dead(inst.body, live);
+    }
+}
+
+static void prune(ssa_program& program) {
+    vector<bool> live(program.values.size(), false);
+    mark_roots(program.body, live);
+    while (mark_edges(program.body, live))
+        ;
+    drop_dead(program.body, live);
+
+    vector<int> initial;
+    for (size_t i = 0; i < program.initial.size(); i++)
+        if (live[program.initial[i]])
+            initial.push_back(program.initial[i]);
+    program.initial.swap(initial);
+}
+
+void build_ssa(st_list* root, ssa_program& program) {
+    ssa_builder b;
+    b.program = &program;
+    b.temporaries = 0;
+    build_list(b, root, program.body);
+    prune(program);
+}
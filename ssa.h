@@ -0,0 +1,71 @@
+#ifndef __SSA_H
+#define __SSA_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "ast.h"
+
+/*
+ * SSA form of a program, built from the AST
+ *
+ * Every assignment, read and operator defines a fresh value. Control flow
+ * stays structured like the source: an if carries the phi nodes of its join,
+ * a loop carries the phi nodes of its header and of its exit. Values used
+ * after an if or a loop always come through one of those phi nodes, so the
+ * C block a value is declared in always encloses all its uses.
+ */
+
+enum ssa_kind {
+    s_binary,   // def = args[0] node->type args[1]
+    s_copy,     // def = args[0]
+    s_read,     // def = args[0], then def = read when there is a number
+    s_write,    // write args[0]
+    s_if,       // if args[0] body, then phis at the join
+    s_loop,     // phis at the header, body, exits set by the checks
+    s_check     // leave the innermost loop unless args[0], copies set its exit phis
+};
+
+struct ssa_value {
+    std::string name;       // C identifier, the literal text for constants
+    std::string var;        // source variable, empty for temporaries
+    bin_op* node;           // operator computing a temporary, for its type
+    bool constant;
+};
+
+// def = args[0] on entry (before the if, before the loop),
+//       args[1] on the other edge (end of then, end of the loop body)
+struct ssa_phi {
+    int def;
+    int args[2];
+};
+
+struct ssa_inst {
+    ssa_kind kind;
+    int def;
+    int args[2];
+    bin_op* node;                       // operator, written expression or condition
+
+    std::vector<ssa_inst> body;
+    std::vector<ssa_phi> phis;
+
+    // s_loop: exit values, one per variable changed in the loop
+    std::vector<ssa_phi> exits;
+    // s_check: exit value <- current value, taken on the way out
+    std::vector<std::pair<int, int> > copies;
+
+    // s_loop: the body starts with the only check of the loop, it is tested
+    // in the loop header against the header phis and not repeated in the body
+    bool hoisted;
+    std::map<std::string, int> header;  // variable -> value at the top of the loop
+};
+
+struct ssa_program {
+    std::vector<ssa_value> values;
+    std::vector<int> initial;           // variables read before any assignment
+    std::vector<ssa_inst> body;
+};
+
+void build_ssa(st_list* root, ssa_program& program);
+
+#endif
@@ -0,0 +1,69 @@
+/* calculator programs compiled by the C++ compiler (embed.h)
+
+    test30 < input
+    runs the program in test30.inc, a source wrapped in a raw string literal,
+    on stdin and writes one number per line like its C would; gcd below is
+    run at compile time. With -DBROKEN=n the file embeds a program that
+    breaks a rule and must not compile
+*/
+
+#include "../embed.h"
+#include <cstdio>
+
+static constexpr auto program = calc::embed(
+#include "test30.inc"
+);
+
+static constexpr auto gcd = calc::embed(R"(
+read a
+read b
+do check b <> 0
+    t := b
+    b := a - a / b * b
+    a := t
+od
+write a
+)");
+
+// reads from an array, for programs run by the compiler
+struct numbers {
+    const long long* next;
+    const long long* end;
+
+    constexpr bool operator()(long long& x) {
+        if (next == end)
+            return false;
+        x = *next++;
+        return true;
+    }
+};
+
+constexpr long long gcd_of(long long a, long long b) {
+    long long input[] = {a, b};
+    numbers read = {input, input + 2};
+    long long result = 0;
+    calc::run<gcd>(read, [&](long long x) { result = x; });
+    return result;
+}
+
+static_assert(gcd.variables == 3 && gcd.slot("b") == 1 && gcd.slot("n") == -1, "variables by first use");
+static_assert(gcd_of(84, 36) == 12, "gcd at compile time");
+static_assert(gcd_of(17, 5) == 1, "gcd at compile time");
+
+#if BROKEN == 1
+static constexpr auto broken = calc::embed("x := 1\ncheck x < 2\n");
+#elif BROKEN == 2
+// the only check belongs to the inner do
+static constexpr auto broken = calc::embed("do\n  do\n    check 0\n  od\nod\n");
+#elif BROKEN == 3
+static constexpr auto broken = calc::embed("do\n  if 1\n    check 0\n  fi\nod\n");
+#elif BROKEN == 4
+static constexpr auto broken = calc::embed("x := (1 + 2\n");
+#endif
+
+int main() {
+    calc::run<program>(
+        [](long long& x) { return scanf("%lld", &x) == 1; },
+        [](long long x) { printf("%lld\n", x); });
+    return 0;
+}
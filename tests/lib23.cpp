@@ -0,0 +1,75 @@
+/* libcalc from many threads at once.
+
+    lib23 <program>...
+    compiles every program once, then all of them again on 8 threads, 25
+    times each, and fails if any concurrent result differs from the first;
+    prints the AST and the semantic report of the first program. A program
+    with a 150 character id goes round with them, and options that do not
+    go together must be refused.
+*/
+
+#include "../calc.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <atomic>
+
+using namespace std;
+
+static bool same(const calc::CompileResult& a, const calc::CompileResult& b) {
+    return a.ok == b.ok && a.ast == b.ast && a.report == b.report
+           && a.diagnostics == b.diagnostics && a.code == b.code;
+}
+
+int main(int argc, char* argv[]) {
+    vector<string> sources;
+    vector<calc::CompileResult> expected;
+    calc::Options options;
+    options.checked = true;
+
+    for (int i = 1; i < argc; i++) {
+        ifstream file(argv[i]);
+        ostringstream text;
+        text << file.rdbuf();
+        sources.push_back(text.str());
+        expected.push_back(calc::compile(sources.back(), options));
+    }
+    sources.push_back(string(150, 'x') + " := 1\nwrite 2\n");
+    expected.push_back(calc::compile(sources.back(), options));
+    if (expected.back().diagnostics.find("150 characters, at most 99") == string::npos) {
+        cerr << "a 150 character id is not refused" << endl;
+        return 1;
+    }
+
+    calc::Options lanes;
+    lanes.lanes = 4;
+    lanes.ssa = true;
+    calc::Options jobs;
+    jobs.jobs = 1 << 30;
+    if (calc::compile(sources[0], lanes).ok || calc::compile(sources[0], jobs).ok) {
+        cerr << "options that do not go together are not refused" << endl;
+        return 1;
+    }
+
+    atomic<int> mismatches(0);
+    vector<thread> threads;
+    for (int t = 0; t < 8; t++) {
+        threads.push_back(thread([&, t]() {
+            for (int round = 0; round < 25; round++) {
+                size_t i = (t + round) % sources.size();
+                if (!same(calc::compile(sources[i], options), expected[i])) {
+                    cerr << "mismatch on " << (i + 1 < (size_t) argc ? argv[i + 1] : "the long id") << endl;
+                    mismatches++;
+                }
+            }
+        }));
+    }
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+
+    if (!expected.empty())
+        cout << expected[0].ast << expected[0].report;
+    return mismatches == 0 ? 0 : 1;
+}
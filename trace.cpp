@@ -0,0 +1,120 @@
+#include "trace.h"
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+bool trace_enabled = false;
+
+static const size_t ring_size = 1 << 17;
+
+struct trace_event {
+    const char* name;
+    uint64_t start;         // ns since trace_start
+    uint64_t duration;
+    int line;
+    char kind;              // 'X' span, 'i' instant
+};
+
+struct trace_lane {
+    vector<trace_event> ring;   // grows by doubling up to ring_size, then wraps
+    size_t written;
+    int tid;
+    const char* name;
+};
+
+// lanes outlive their threads, trace_write runs after they are joined
+static mutex lanes_lock;
+static vector<unique_ptr<trace_lane> > lanes;
+static chrono::steady_clock::time_point origin;
+static thread_local trace_lane* self;
+
+static trace_lane* lane() {
+    if (!self) {
+        unique_ptr<trace_lane> created(new trace_lane);
+        created->written = 0;
+        created->name = NULL;
+        lock_guard<mutex> hold(lanes_lock);
+        created->tid = lanes.size() + 1;
+        self = created.get();
+        lanes.push_back(move(created));
+    }
+    return self;
+}
+
+uint64_t trace_now() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - origin).count();
+}
+
+static void record(const char* name, uint64_t start, uint64_t duration, int line, char kind) {
+    trace_lane* l = lane();
+    trace_event e = {name, start, duration, line, kind};
+    if (l->ring.size() < ring_size) {
+        if (l->ring.size() == l->ring.capacity())
+            l->ring.reserve(l->ring.empty() ? 1024 : l->ring.size() * 2);
+        l->ring.push_back(e);
+    } else {
+        l->ring[l->written % ring_size] = e;
+    }
+    l->written++;
+}
+
+void trace_record(const char* name, uint64_t start, int line) {
+    record(name, start, trace_now() - start, line, 'X');
+}
+
+void trace_instant(const char* name, int line) {
+    if (trace_enabled)
+        record(name, trace_now(), 0, line, 'i');
+}
+
+void trace_thread(const char* name) {
+    if (trace_enabled)
+        lane()->name = name;
+}
+
+void trace_start() {
+    origin = chrono::steady_clock::now();
+    trace_enabled = true;
+    trace_thread("main");
+}
+
+bool trace_write(const char* path) {
+    FILE* out = fopen(path, "w");
+    if (!out)
+        return false;
+    lock_guard<mutex> hold(lanes_lock);
+    size_t dropped = 0;
+    const char* separator = "\n";
+    fprintf(out, "{\"traceEvents\": [");
+    for (size_t i = 0; i < lanes.size(); i++) {
+        const trace_lane& l = *lanes[i];
+        fprintf(out, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"",
+                separator, l.tid);
+        if (l.name)
+            fprintf(out, "%s\"}}", l.name);
+        else
+            fprintf(out, "thread %d\"}}", l.tid);
+        separator = ",\n";
+
+        size_t first = l.written > ring_size ? l.written - ring_size : 0;
+        dropped += first;
+        for (size_t n = first; n < l.written; n++) {
+            const trace_event& e = l.ring[n % ring_size];
+            fprintf(out, ",\n{\"name\": \"%s\", \"ph\": \"%c\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f",
+                    e.name, e.kind, l.tid, e.start / 1000.0);
+            if (e.kind == 'X')
+                fprintf(out, ", \"dur\": %.3f", e.duration / 1000.0);
+            else
+                fprintf(out, ", \"s\": \"t\"");
+            if (e.line)
+                fprintf(out, ", \"args\": {\"line\": %d}", e.line);
+            fprintf(out, "}");
+        }
+    }
+    fprintf(out, "\n], \"displayTimeUnit\": \"ms\", \"otherData\": {\"dropped events\": %zu}}\n", dropped);
+    return fclose(out) == 0;
+}
@@ -0,0 +1,52 @@
+#ifndef __TRACE_H
+#define __TRACE_H
+
+#include <cstdint>
+
+/*
+ * timeline of one run (parse --trace=file.json) in the Chrome trace event
+ * format, for chrome://tracing and ui.perfetto.dev
+ *
+ * A trace_span is one complete event on the lane of the thread it ran on,
+ * trace_instant marks a point, error recovery in the parser. Every thread
+ * records into a ring of its own: no lock, a clock read at each end of a
+ * span, an allocation only while the ring grows to its size; after that the
+ * oldest events are overwritten, the file tells how many were. Names are
+ * string literals, they are kept as pointers.
+ *
+ * Nothing is recorded until trace_start, before any thread starts; until
+ * then a span costs a test of trace_enabled.
+ */
+extern bool trace_enabled;
+
+uint64_t trace_now();
+void trace_record(const char* name, uint64_t start, int line);
+
+class trace_span {
+public:
+    // no name records nothing
+    explicit trace_span(const char* name, int line = 0) : name(name), line(line), start(0) {
+        if (trace_enabled && name)
+            start = trace_now();
+    }
+    ~trace_span() {
+        if (trace_enabled && name)
+            trace_record(name, start, line);
+    }
+private:
+    const char* name;
+    int line;           // of the source, 0: none
+    uint64_t start;
+};
+
+void trace_instant(const char* name, int line);
+
+// what the lane of this thread is called, "thread N" unless named
+void trace_thread(const char* name);
+
+void trace_start();
+
+// every lane so far, false when path cannot be written
+bool trace_write(const char* path);
+
+#endif
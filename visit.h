@@ -0,0 +1,114 @@
+#ifndef __VISIT_H
+#define __VISIT_H
+
+#include <cstddef>
+#include <iostream>
+#include <tuple>
+#include <utility>
+#include "ast.h"
+
+/*
+ * walks over the statements, several consumers in one pass
+ *
+ * A consumer derives from ast_visitor<itself> and hides the hooks it needs:
+ * enter(s) in pre-order, returning whether it wants the statements in the
+ * body of s, and leave(s) after them, only when it did. Calls go straight
+ * to the consumer, no virtual functions, so a walk costs what the switch
+ * of a hand-written recursion would.
+ *
+ * fused_walk runs consumers side by side: each statement is entered by all
+ * of them, in the order given, before the walk goes on to the next, so the
+ * tree is read from memory once instead of once per consumer. A consumer
+ * that declines a body hears nothing until the walk has left it, the body
+ * is skipped only when every consumer declined.
+ */
+template <class Derived>
+class ast_visitor {
+public:
+    bool enter(st*) { return true; }
+    void leave(st*) {}
+
+    void visit(st* statement) {
+        Derived& self = static_cast<Derived&>(*this);
+        if (!self.enter(statement))
+            return;
+        walk(statement->sl, NULL);
+        self.leave(statement);
+    }
+
+    // from first up to, not including, last (NULL: to the end)
+    void walk(st_list* first, st_list* last) {
+        for (st_list* sl = first; sl != last; sl = sl->r_child)
+            if (sl->l_child)
+                visit(sl->l_child);
+    }
+};
+
+template <class... Consumers>
+class fused_visitor : public ast_visitor<fused_visitor<Consumers...> > {
+public:
+    explicit fused_visitor(Consumers&... consumers) : consumers(consumers...), quiet() {}
+
+    bool enter(st* statement) {
+        bool wanted = enter(statement, std::index_sequence_for<Consumers...>());
+        if (!wanted)
+            for (size_t i = 0; i < sizeof...(Consumers); i++)
+                quiet[i]--;
+        return wanted;
+    }
+
+    void leave(st* statement) {
+        leave(statement, std::index_sequence_for<Consumers...>());
+    }
+
+private:
+    template <size_t... I>
+    bool enter(st* statement, std::index_sequence<I...>) {
+        bool wanted = false;
+        ((wanted |= enter_one(std::get<I>(consumers), quiet[I], statement)), ...);
+        return wanted;
+    }
+
+    template <size_t... I>
+    void leave(st* statement, std::index_sequence<I...>) {
+        (leave_one(std::get<I>(consumers), quiet[I], statement), ...);
+    }
+
+    // quiet: how deep the walk is inside a statement whose body the consumer declined
+    template <class Consumer>
+    static bool enter_one(Consumer& consumer, int& quiet, st* statement) {
+        if (quiet || !consumer.enter(statement)) {
+            quiet++;
+            return false;
+        }
+        return true;
+    }
+
+    template <class Consumer>
+    static void leave_one(Consumer& consumer, int& quiet, st* statement) {
+        if (quiet)
+            quiet--;
+        else
+            consumer.leave(statement);
+    }
+
+    std::tuple<Consumers&...> consumers;
+    int quiet[sizeof...(Consumers)];
+};
+
+template <class... Consumers>
+void fused_walk(st_list* first, st_list* last, Consumers&... consumers) {
+    fused_visitor<Consumers...>(consumers...).walk(first, last);
+}
+
+// the AST as the tests expect it, print_program_ast without the program around it (ast.cpp)
+class ast_printer : public ast_visitor<ast_printer> {
+public:
+    explicit ast_printer(std::ostream& out) : out(out) {}
+    bool enter(st* statement);
+    void leave(st* statement);
+private:
+    std::ostream& out;
+};
+
+#endif